@@ -0,0 +1,113 @@
+#include "ADC_Sampler.h"
+
+#if defined(__AVR__)
+#include <util/atomic.h>
+#endif
+
+ADC_Sampler::ADC_Sampler() {
+	_channels = 0;
+	_extra = 0;
+	_running = false;
+	for (uint8_t i = 0; i < ADC_SAMPLER_CHANNELS; i++) {
+		_value[i] = 0;
+		_count[i] = 0;
+	}
+}
+
+int8_t ADC_Sampler::addChannel(uint8_t pin) {
+	if (_running || (_channels >= ADC_SAMPLER_CHANNELS)) return -1;
+#if defined(analogPinToChannel)
+	_mux[_channels] = analogPinToChannel((pin >= A0) ? pin - A0 : pin);
+#elif defined(A0)
+	_mux[_channels] = (pin >= A0) ? pin - A0 : pin;
+#else
+	_mux[_channels] = pin;
+#endif
+	return _channels++;
+}
+
+#if defined(ADCSRA) && defined(ADC_vect)
+
+// AVcc reference as analogRead() with DEFAULT
+void ADC_Sampler::select(uint8_t index) {
+	_current = index;
+	_samples = 1 << (2 * _extra);
+	_sum = 0;
+	_discard = true;
+	ADMUX = _BV(REFS0) | (_mux[index] & 0x07);
+#if defined(MUX5)
+	if (_mux[index] & 0x08) ADCSRB |= _BV(MUX5);
+	else ADCSRB &= ~_BV(MUX5);
+#endif
+}
+
+bool ADC_Sampler::begin(uint8_t extraBits) {
+	if (!_channels) return false;
+	end();
+	_extra = (extraBits > ADC_SAMPLER_MAX_EXTRA) ? ADC_SAMPLER_MAX_EXTRA : extraBits;
+	select(0);
+	_running = true;
+	// the core has already set the prescaler for 125 kHz, keep it
+	ADCSRA |= _BV(ADEN) | _BV(ADIF);
+	ADCSRA |= _BV(ADIE) | _BV(ADSC);
+	return true;
+}
+
+void ADC_Sampler::end() {
+	ADCSRA &= ~_BV(ADIE);
+	// let a running conversion finish, analogRead() may follow
+	while (ADCSRA & _BV(ADSC));
+	_running = false;
+}
+
+void ADC_Sampler::handleInterrupt() {
+	uint16_t sample = ADC;
+	if (_discard) {
+		// the sample and hold may still carry the previous channel
+		_discard = false;
+	} else {
+		_sum += sample;
+		if (!--_samples) {
+			_value[_current] = _sum >> _extra;
+			_count[_current]++;
+			select((_current + 1 < _channels) ? _current + 1 : 0);
+		}
+	}
+	ADCSRA |= _BV(ADSC);
+}
+
+uint16_t ADC_Sampler::read(uint8_t index) {
+	if (index >= _channels) return 0;
+	uint16_t v;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		v = _value[index];
+	}
+	return v;
+}
+
+#else
+
+void ADC_Sampler::select(uint8_t index) {
+	_current = index;
+}
+
+bool ADC_Sampler::begin(uint8_t extraBits) {
+	_extra = extraBits;
+	return false;
+}
+
+void ADC_Sampler::end() {
+}
+
+void ADC_Sampler::handleInterrupt() {
+}
+
+uint16_t ADC_Sampler::read(uint8_t index) {
+	return (index < _channels) ? _value[index] : 0;
+}
+
+#endif
+
+uint8_t ADC_Sampler::count(uint8_t index) {
+	return (index < _channels) ? _count[index] : 0;
+}
@@ -0,0 +1,69 @@
+#ifndef ADC_Sampler_h
+#define ADC_Sampler_h
+
+/*
+  ADC_Sampler  background analog sampling with oversampling
+
+  The ADC-complete interrupt starts the next conversion itself and walks
+  through the configured channels. Each channel sums 4^extraBits
+  conversions and publishes the sum shifted right by extraBits, a value
+  with 10 + extraBits bits. Readings are as fresh as the ADC clock makes
+  them, whatever loop() does, and read() costs a copy.
+
+  The sketch owns the vector:
+    ISR(ADC_vect) { sampler.handleInterrupt(); }
+
+  While the sampler runs it owns the ADC, do not call analogRead().
+  AVR only, begin() returns false elsewhere.
+*/
+
+#include <inttypes.h>
+#if defined(ARDUINO) && (ARDUINO >= 100)
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#ifndef ADC_SAMPLER_CHANNELS
+#define ADC_SAMPLER_CHANNELS 4
+#endif
+#define ADC_SAMPLER_MAX_EXTRA 3  // 64 conversions per value
+
+class ADC_Sampler {
+public:
+	ADC_Sampler();
+
+	// Adds an analog pin (A0..A7), returns its index for read() or -1
+	int8_t addChannel(uint8_t pin);
+
+	// Starts sampling, extraBits 0..3 on top of the 10-bit ADC
+	bool begin(uint8_t extraBits = 2);
+	void end();
+
+	// Latest value of channel index, 10 + extraBits bits
+	uint16_t read(uint8_t index);
+
+	// Values published for channel index so far, wraps at 255
+	uint8_t count(uint8_t index);
+
+	// Call from ISR(ADC_vect)
+	void handleInterrupt();
+
+private:
+	void select(uint8_t index);
+
+	uint8_t _mux[ADC_SAMPLER_CHANNELS];
+	uint8_t _channels;
+	uint8_t _extra;
+	bool _running;
+
+	// interrupt side
+	volatile uint16_t _value[ADC_SAMPLER_CHANNELS];
+	volatile uint8_t _count[ADC_SAMPLER_CHANNELS];
+	uint8_t _current;
+	uint8_t _samples;   // conversions left for the current value
+	bool _discard;      // first conversion after a mux change
+	uint16_t _sum;      // 64 conversions of 1023 still fit
+};
+
+#endif // ADC_Sampler_h
@@ -0,0 +1,88 @@
+#include "Keypad_I2C.h"
+#include "LCD_I2C.h"
+#include "I2C_Scheduler.h"
+
+// Four Nano PRO boards on one bus, set to different addresses with the
+// A0, A1, A2 jumpers on their backs (see Nano_Pro_Sample). Each shows a
+// counter and the last key pressed on it. I2C_Scheduler interleaves the
+// display updates and keypad scans of all boards, so a redraw on one of
+// them does not hold up the keypads of the others.
+
+#define STATIONS 4
+const byte addresses[STATIONS] = { 0x27, 0x26, 0x25, 0x24 };
+
+const byte ROWS = 4;
+const byte COLS = 4;
+char keys[ROWS][COLS] = {
+  {'1','2','3','*'},
+  {'4','5','6','/'},
+  {'7','8','9','-'},
+  {'.','0','=','+'}
+};
+byte rowPins[] = {3,2,1,0};
+byte colPins[] = {4,5,6,7};
+
+LCD_I2C lcd[STATIONS] = {
+  LCD_I2C(addresses[0]), LCD_I2C(addresses[1]), LCD_I2C(addresses[2]), LCD_I2C(addresses[3])
+};
+Keypad_I2C keypad[STATIONS] = {
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, addresses[0]),
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, addresses[1]),
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, addresses[2]),
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, addresses[3])
+};
+
+I2C_Scheduler bus;
+unsigned long lastUpdate = 0;
+unsigned long lastReport = 0;
+long counter = 0;
+
+void setup()
+{
+  Serial.begin(115200);
+  Wire.begin();
+  Wire.setClock(400000);
+  for (byte i = 0; i < STATIONS; i++) {
+    keypad[i].begin();
+    bus.addStation(&lcd[i], &keypad[i]);  // puts the display into asynchronous mode
+    lcd[i].begin(16, 2);
+    lcd[i].enableFramebuffer();
+    lcd[i].setBacklight(HIGH);
+    lcd[i].printField(0, 0, 16, "Station");
+    lcd[i].printField(8, 0, 1, i + 1);
+    lcd[i].printField(0, 1, 4, "Key");
+  }
+}
+
+void loop()
+{
+  bus.run();  // one keypad scan or display transaction
+
+  for (byte i = 0; i < STATIONS; i++) {
+    char key = bus.getKey(i);
+    if (key) {
+      char text[2] = { key, 0 };
+      lcd[i].printField(4, 1, 1, text);
+    }
+  }
+
+  // the screens only change in RAM, the scheduler sends the difference
+  if (millis() - lastUpdate >= 100) {
+    lastUpdate = millis();
+    counter++;
+    for (byte i = 0; i < STATIONS; i++) lcd[i].printField(9, 1, 7, counter);
+  }
+
+  // bus bytes per second and worst keypad scan delay per station
+  if (millis() - lastReport >= 10000) {
+    lastReport = millis();
+    for (byte i = 0; i < STATIONS; i++) {
+      Station_Stats &s = bus.getStats(i);
+      Serial.print(F("station ")); Serial.print(i + 1);
+      Serial.print(F(" bytes/s ")); Serial.print(bus.throughput(i));
+      Serial.print(F(" scans ")); Serial.print(s.scans);
+      Serial.print(F(" scan late ")); Serial.println(s.scanLateMax);
+      bus.resetStats(i);
+    }
+  }
+}
@@ -1,6 +1,9 @@
 #include "Keypad_I2C.h"
 #include "LCD_I2C.h"
 #include "FR_RotaryEncoder.h"
+#include "NTC_Thermistor.h"
+#include "ADC_Sampler.h"
+#include "Task_Scheduler.h"
 
 // I2C address for MCP23017
 // if needed it can be reconfigured at back of the board via A0,A1,A2
@@ -40,51 +43,132 @@ byte colPins[] = {4,5,6,7}; //connections of the column pinouts of the keypad
 Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS,I2CADDR);
 
 // Encoder configuration on Nano
-int pinSCK = 8; // Interrupt pin for rotary encoder. Can be 2 or 3      
-int pinDT = 9; // Better select a pin from 4 to 7
-int pinSW = 7; // Interrupt pin for switch. Can be 2 or 3 
+const byte pinSCK = 8; // Pins 8 and 9 share pin-change interrupt PCINT0      
+const byte pinDT = 9; // on the same group
+const byte pinSW = 7; // Interrupt pin for switch. Can be 2 or 3 
 
 // Definition encoder using "FR_RotaryEncoder.h" library 
-RotaryEncoder Encoder(pinSCK, pinDT, pinSW);
+// Pins fixed at compile time: direct port reads instead of digitalRead()
+RotaryEncoderT<pinSCK, pinDT, pinSW> Encoder;
 int lastPosition;
 int currentPosition=0;
 
 // NTC 10K confugiration
-// These coefficent for NTC 10K give more accurate result in temp calculation
-// For a 10 kohm thermistor, the value of constants A, B and C are:
 #define NTC A6  // connection pin on Nano
-float A = 0.001125308852122;
-float B = 0.000234711863267;
-float C = 0.000000085663516;
-float R1 = 10000;
-float Temp;
-float R2;
-float Rlog;
+
+//The Steinhart and Hart equation is an empirical expression that has been determined to be the best
+//mathematical expression for the resistance - temperature relationship of a negative temperature
+//coefficient thermistor. It is usually found explicit in T where T is expressed in degrees Kelvin.
+//    Steinhart - Hart Equation 1/T = A+B(LnR)+C(LnR)^3
+//       T = Temperature in degrees Kelvin, 
+//       LnR is the Natural Log of the measured resistance of the thermistor, 
+//       A, B and C are constants.
+//The coefficients A, B and C are found by taking the resistance of the thermistor at three
+//temperatures and solving three simultaneous equations.
+//
+// Vin --------
+//            |
+//           R1 (10K)
+//            |
+//             ------ Vo
+//            |
+//           R2 (NTC 10K)
+//            |
+// GND---------
+// This the circuit for NTC on Nano PRO board
+//
+// The compiler solves the equation into a table in flash, the sketch only
+// interpolates in integer math. R1, A, B, C for a 10 kohm thermistor:
+NTC_TABLE(ntcTable, 10000, 0.001125308852122, 0.000234711863267, 0.000000085663516);
+NTC_Thermistor ntc(NTC, ntcTable);
 
 //LCD configuration
 LCD_I2C lcd(I2CADDR);
 
-int LDRCount = 0; 
-int NTCCount = 0; 
+// LDR and NTC sampled in the background, 12 bits from 16 conversions each
+ADC_Sampler sensors;
+int8_t ldrChannel;
+int8_t ntcChannel;
+
+// Everything in loop() runs as a task with a fixed rate
+Task_Scheduler tasks;
 
 int menuLength = 5;// number of test
 
+// Encoder pins 8 and 9 are PB0 and PB1
+ISR(PCINT0_vect) {
+  Encoder.rotaryUpdate();
+}
+
+ISR(ADC_vect) {
+  sensors.handleInterrupt();
+}
+
 void setup() {
   Serial.begin(9600); 
   keypad.begin( );
+  keypad.enableInterrupt( ); // scan only after a row input changes (INTFA)
+  lcd.enableAsync();  // queued LCD traffic, sent by lcd.poll() from loop()
   lcd.begin(16, 2); 
+  lcd.enableFramebuffer(); // only changed cells go to the panel, see lcd.flush()
   lcd.clear();  
   pinMode(LDR,INPUT); 
   pinMode(NTC,INPUT);      
+  ldrChannel = sensors.addChannel(LDR);
+  ntcChannel = sensors.addChannel(NTC);
+  sensors.begin(2);  // owns the ADC from here on, no analogRead()
   pinMode(Relay,OUTPUT); 
  
   Encoder.enableInternalSwitchPullup(); 
   Encoder.setRotaryLogic(true);    // Reverses the CW - CCW direction if needed
   Encoder.setRotaryLimits(0, menuLength-1, false);   // Sets the limits and mode
+  Encoder.enableInterrupts();  // rotary decoded in ISR(PCINT0_vect) below
  
   dispTitle = true;
   displayTest( 0 );
   dispTitle = false;
+
+  tasks.every(    1000UL, encoderTask);      // switch debounce wants 1 ms
+  tasks.every(   20000UL, menuTask);         // 50 Hz, keypad and encoder button
+  tasks.every(   20000UL, flushTask, 10000); // 50 Hz, between two menu runs
+  tasks.every(  250000UL, getLDR);
+  tasks.every(  500000UL, getNTC);
+  tasks.every(10000000UL, reportTask);       // task statistics to Serial
+}
+
+void encoderTask()
+{
+  Encoder.update();// update both for switch and rotary
+  currentPosition = Encoder.getPosition();  // Rotary 
+  if (lastPosition != currentPosition)
+  {
+    lastPosition = currentPosition;
+    dispTitle = true;
+  }
+}
+
+void menuTask()
+{
+  displayTest( lastPosition );
+}
+
+void flushTask()
+{
+  lcd.flush();
+}
+
+// runs, overruns and worst lateness/run time in us per task
+void reportTask()
+{
+  for (int8_t i = 0; i < TASK_SCHEDULER_MAX; i++) {
+    Task_Stats &s = tasks.getStats(i);
+    if (!s.runs) continue;
+    Serial.print(F("task ")); Serial.print(i);
+    Serial.print(F(" runs ")); Serial.print(s.runs);
+    Serial.print(F(" overruns ")); Serial.print(s.overruns);
+    Serial.print(F(" late ")); Serial.print(s.lateMax);
+    Serial.print(F(" run ")); Serial.println(s.runMax);
+  }
 }
 
 void displayTest(int c)
@@ -105,7 +189,6 @@ void displayTest(int c)
               lcd.setCursor(0,1);lcd.print("LDR :           ");
               dispTitle = false;
             }
-           getLDR();  // if reading is less than 350 then the backlight of LCD will be OFF 
            break;
  
   case 2 : if (dispTitle)
@@ -114,7 +197,6 @@ void displayTest(int c)
               lcd.setCursor(0,1);lcd.print("Temp :          ");
               dispTitle = false;
            }
-           getNTC();
            break;
  
   case 3 : if (dispTitle)
@@ -123,16 +205,13 @@ void displayTest(int c)
               lcd.setCursor(0,1);lcd.print("Relay is        ");                   
               dispTitle = false;
            }
-           // if encoder button pressed           
-           Button = Encoder.getSwitchState();
-           if ( Button  ) 
+           // if encoder button clicked, one event per click
+           Button = Encoder.getSwitchEvent();
+           if ( Button == RotaryEncoder::EV_CLICK ) 
             { 
               int relayStatus = digitalRead(Relay);
               digitalWrite(Relay,!relayStatus);
-              lcd.setCursor(9,1);
-              if (!relayStatus) lcd.print("ON ");
-              else              lcd.print("OFF");
-              delay(250);// wait until the button is released
+              lcd.printField(9,1,3, relayStatus ? "OFF" : "ON");
             }
            break;
   
@@ -144,9 +223,7 @@ void displayTest(int c)
            }
            // if a test chosen (button pressed)           
            Button = Encoder.getSwitchState();
-           lcd.setCursor(3,1);
-           if ( Button )  lcd.print("pressed ");
-           else           lcd.print("released");
+           lcd.printField(3,1,8, Button ? "pressed" : "released");
             
            break;
   default: break;
@@ -159,74 +236,30 @@ void getKey()
   if (key){ lcd.setCursor(6,1); lcd.print(key); }
 }
 
-// reads LDR every 10000th
+// LDR task, 4 times a second on the LDR test
+// if reading is less than 350 then the backlight of LCD will be OFF 
 void getLDR()
 {
-  if ( LDRCount % 10000 == 0 ){
-    Lx = analogRead(LDR);
-    lcd.setCursor(6,1);lcd.print(Lx);
-    if (Lx < 350) lcd.setBacklight(LOW);
-    else lcd.setBacklight(HIGH);
-  }
-  LDRCount++;
-}
-
-//The Steinhart and Hart equation is an empirical expression that has been determined to be the best
-//mathematical expression for the resistance - temperature relationship of a negative temperature
-//coefficient thermistor. It is usually found explicit in T where T is expressed in degrees Kelvin.
-//    Steinhart - Hart Equation 1/T = A+B(LnR)+C(LnR)^3
-//       T = Temperature in degrees Kelvin, 
-//       LnR is the Natural Log of the measured resistance of the thermistor, 
-//       A, B and C are constants.
-//For a 10 kohm thermistor, the value of constants A, B and C are:
-//A = 0.001125308852122
-//B = 0.000234711863267
-//C = 0.000000085663516
-//The coefficients A, B and C are found by taking the resistance of the thermistor at three
-//temperatures and solving three simultaneous equations.
-
-float Thermistor(int Vo) {
-  // Vin --------
-  //            |
-  //           R1 
-  //            |
-  //             ------ Vo
-  //            |
-  //           R2 (NTC 10K)
-  //            |
-  // GND---------
-  // This the circuit for NTC on Nano PRO board
-  
-  R2 = ( (Vo*R1) / (1024-Vo) ); // this is the right formula for nano pro board 
-  Rlog = log( R2 ) ;   // convert R2 into log 
-  Temp = ( 1 / (A + B * Rlog + C * Rlog * Rlog * Rlog )) ; // in Kelvin
-  Temp = Temp - 273.15; // Convert it to Celcius        
-  return Temp;   // return it
+  if ( lastPosition != 1 || dispTitle ) return;
+  Lx = sensors.read(ldrChannel) >> 2;  // back to 10 bits for the threshold
+  lcd.printField(6,1,4,Lx,0,LCD_ALIGN_LEFT);
+  if (Lx < 350) lcd.setBacklight(LOW);
+  else lcd.setBacklight(HIGH);
 }
 
-
+// NTC task, twice a second on the NTC test
 void getNTC()
 {
-  if (NTCCount % 10000 == 0 ) 
-  { 
-    lcd.setCursor(7,1); 
-    lcd.print( Thermistor( analogRead(NTC) ) );
-    lcd.print((char)223);lcd.print("C"); // display celcius sign
-  }
-  NTCCount++;
+  if ( lastPosition != 2 || dispTitle ) return;
+  // centi-degrees shown with two decimals, followed by the celcius sign
+  lcd.printField(7,1,6, ntc.centiCelsius( sensors.read(ntcChannel), 2 ), 2);
+  lcd.print((char)223);lcd.print("C");
 }
 
 void loop()
 {
-  Encoder.update();// update both for switch and rotary
-  currentPosition = Encoder.getPosition();  // Rotary 
-  while (lastPosition != currentPosition)
-  {
-    lastPosition = currentPosition;
-    //delay(10);
-    dispTitle = true;
-  }
-  displayTest( lastPosition );
+  tasks.run();
+  lcd.poll();  // one queued LCD transaction, if any
 }
 
  
@@ -40,6 +40,27 @@
 
 #include "FR_RotaryEncoder.h"
 
+#include <stdlib.h>
+
+// int is two bytes on AVR, the ISR may change it between the two loads
+#if defined(__AVR__)
+  #include <util/atomic.h>
+  #define ROTARY_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+  #define ROTARY_ATOMIC
+#endif
+
+// Quadrature transitions, indexed by previous state * 4 + current state,
+// state = A * 2 + B. CW runs 00 -> 10 -> 11 -> 01 -> 00.
+// A jump over a state (both lines changed) is invalid and counts 0, bounce
+// on one line counts +1 and -1 and cancels out.
+static const int8_t quadratureTable[16] = {
+   0, -1,  1,  0,
+   1,  0,  0, -1,
+  -1,  0,  0,  1,
+   0,  1, -1,  0
+};
+
 RotaryEncoder::RotaryEncoder(int rotaryPinCLK, int rotaryPinDT, int switchPinSW)
 {
 	//Definitions
@@ -54,9 +75,8 @@ RotaryEncoder::RotaryEncoder(int rotaryPinCLK, int rotaryPinDT, int switchPinSW)
     // Internal usage is based on XOR and is opposite of user input 
     switchLogic = !(switchLogic);
 
-    // Set the initial value to a0 and b0 as the current pin states
-    a0 = digitalRead(pinA);
-    b0 = digitalRead(pinB);
+    // Start decoding from the current pin states
+    rotaryState = (digitalRead(pinA) << 1) | digitalRead(pinB);
   
 }
 
@@ -78,23 +98,37 @@ void RotaryEncoder::enableInternalRotaryPullups()
 {
   pinMode(pinA, INPUT_PULLUP);
   pinMode(pinB, INPUT_PULLUP);
+  ROTARY_ATOMIC {
+    rotaryState = (digitalRead(pinA) << 1) | digitalRead(pinB);
+    quarterSteps = 0;
+  }
 }
 
 int RotaryEncoder::getDirection()
 {
-	return direction;
+  int d;
+  ROTARY_ATOMIC {
+    d = direction;
+  }
+	return d;
 }
 
 int RotaryEncoder::getPosition()
 {
-	return rotaryPosition;
+  int p;
+  ROTARY_ATOMIC {
+    p = rotaryPosition;
+  }
+	return p;
 }
 
 void RotaryEncoder::setPosition(int newPosition)
 {
-	rotaryPosition = newPosition;
+  ROTARY_ATOMIC {
+    rotaryPosition = newPosition;
     // After an arbitrary set, the direction is ambiguous
     direction = NOT_MOVED;
+  }
 }
 
 void RotaryEncoder::setMaxValue(int newMaxValue)
@@ -122,54 +156,98 @@ void RotaryEncoder::setRotationalStep(int step)
 	rotationalStep = step;
 }
 
+void RotaryEncoder::setAcceleration(uint8_t maxFactor, unsigned int slowTime, unsigned int fastTime)
+{
+  ROTARY_ATOMIC {
+    accelFactor = maxFactor ? maxFactor : 1;
+    accelSlow = slowTime;
+    accelFast = (fastTime < slowTime) ? fastTime : slowTime;
+  }
+}
+
+int RotaryEncoder::acceleratedStep(bool sameDirection)
+{
+  unsigned long now = millis();
+  unsigned long interval = now - lastCountTime;
+  lastCountTime = now;
+
+  if ((accelFactor <= 1) || !sameDirection || (interval >= accelSlow))
+    return rotationalStep;
+  if (interval <= accelFast)
+    return rotationalStep * accelFactor;
+  // linear between a single step at slowTime and the full factor at fastTime
+  unsigned int factor = 1 + (unsigned long)(accelFactor - 1) * (accelSlow - interval) / (accelSlow - accelFast);
+  return rotationalStep * factor;
+}
+
 void RotaryEncoder::rotaryUpdate()
 //Can be called from interrupt or loop
 {
-  int a = digitalRead(pinA);
-  int b = digitalRead(pinB);
-  if (a != a0) { 
-    a0 = a;
-    if (b0 == ROTARY_POSITION_UNKNOWN) {
-      b0 = b;
-      return;
-    }
-    if (b != b0) {
-      //Serial.print("a= ");Serial.print(a); Serial.print(" b="); Serial.println(b);
-
-      // Both signals A and B change at a 90 degree phase. Therefore, bouncing 
-      // of one signal has (hopefully) ended when the other signal changes.
-      // We now know that both a and b have changed, so we have a valid transition,
-      // not suffering from bounce.
-
-      // Now we check the current states of A and B to identify the rotation direction.
-      changeRotaryValue(!(a == b));
-      /*
-      This is the same as:
-      if (a) {
-        // Rising edge of A, new a=1
-        if (b) 
-          changeRotaryValue(false); // a=1 and b=1, CCW
-        else
-          changeRotaryValue(true); // a=1 and b=0, CW
-      } else {
-        // Falling edge of A, new a is 0
-        if (b)
-          changeRotaryValue(true); // a=0 and b=1, CW
-        else
-          changeRotaryValue(false); // a=0 and b=0, CCW
-      }
-      */
-
-      if (sensitive) {
-        //Serial.println("Fast");
-        b0 = b;
-      } else {
-        // This makes previous B unknown, so the encoder always requires two steps to make one change
-        //Serial.println("Slow");
-        b0 = ROTARY_POSITION_UNKNOWN; 
-      }
+  rotaryDecode((digitalRead(pinA) << 1) | digitalRead(pinB));
+}
+
+void RotaryEncoder::rotaryDecode(uint8_t state)
+{
+  if (state == rotaryState) return;
+  int8_t steps = quarterSteps + quadratureTable[(rotaryState << 2) | state];
+  rotaryState = state;
+
+  // A full quadrature cycle is four transitions.
+  // Sensitive mode counts every half cycle, otherwise every full cycle.
+  int8_t perCount = sensitive ? 2 : 4;
+  if (steps >= perCount) {
+    steps -= perCount;
+    changeRotaryValue(true);
+  } else if (steps <= -perCount) {
+    steps += perCount;
+    changeRotaryValue(false);
+  }
+  quarterSteps = steps;
+}
+
+// ----- Pin-change interrupts -----
+
+bool RotaryEncoder::pinChange(bool enable)
+{
+#if defined(digitalPinToPCICR)
+  volatile uint8_t *icrA = digitalPinToPCICR(pinA);
+  volatile uint8_t *icrB = digitalPinToPCICR(pinB);
+  if ((icrA == 0) || (icrB == 0))
+    return false;
+  ROTARY_ATOMIC {
+    if (enable) {
+      *digitalPinToPCMSK(pinA) |= bit(digitalPinToPCMSKbit(pinA));
+      *digitalPinToPCMSK(pinB) |= bit(digitalPinToPCMSKbit(pinB));
+      // a stale flag would call the ISR right away, harmless but pointless
+      PCIFR = bit(digitalPinToPCICRbit(pinA)) | bit(digitalPinToPCICRbit(pinB));
+      *icrA |= bit(digitalPinToPCICRbit(pinA));
+      *icrB |= bit(digitalPinToPCICRbit(pinB));
+    } else {
+      // other pins of the group may still use it, only unmask ours
+      *digitalPinToPCMSK(pinA) &= ~bit(digitalPinToPCMSKbit(pinA));
+      *digitalPinToPCMSK(pinB) &= ~bit(digitalPinToPCMSKbit(pinB));
     }
   }
+  return true;
+#else
+  (void)enable;
+  return false;
+#endif
+}
+
+bool RotaryEncoder::enableInterrupts()
+{
+  ROTARY_ATOMIC {
+    rotaryState = (digitalRead(pinA) << 1) | digitalRead(pinB);
+  }
+  interruptMode = pinChange(true);
+  return interruptMode;
+}
+
+void RotaryEncoder::disableInterrupts()
+{
+  pinChange(false);
+  interruptMode = false;
 }
 
 void RotaryEncoder::changeRotaryValue(bool leftRight)
@@ -178,12 +256,16 @@ void RotaryEncoder::changeRotaryValue(bool leftRight)
 
   leftRight ^= rotaryLogic;
 
+  int step = acceleratedStep(direction == (leftRight ? CW : CCW));
+  uint8_t event;
   if (leftRight) {
-    nextRotaryPosition = rotaryPosition + rotationalStep;
+    nextRotaryPosition = rotaryPosition + step;
     direction = CW;
+    event = EV_CW;
   } else {
-    nextRotaryPosition = rotaryPosition - rotationalStep;
+    nextRotaryPosition = rotaryPosition - step;
     direction = CCW;
+    event = EV_CCW;
   }
 
   if (wrapMode) {
@@ -195,6 +277,13 @@ void RotaryEncoder::changeRotaryValue(bool leftRight)
       rotaryPosition = nextRotaryPosition;		
     
   } else {
+    // An accelerated step stops at the limit instead of short of it
+    if (step > rotationalStep) {
+      if ((nextRotaryPosition > maxValue) && (rotaryPosition < maxValue))
+        nextRotaryPosition = maxValue;
+      else if ((nextRotaryPosition < minValue) && (rotaryPosition > minValue))
+        nextRotaryPosition = minValue;
+    }
     // Make sure that transitions remain within the range
     if ((nextRotaryPosition > maxValue) || (nextRotaryPosition < minValue)){
       // do not change position
@@ -204,6 +293,8 @@ void RotaryEncoder::changeRotaryValue(bool leftRight)
     }      
   }
 
+  pushEvent(event);
+
 //  Serial.print("Direction "); Serial.println(direction);
 //  Serial.print("Position "); Serial.println(rotaryPosition);
 
@@ -247,6 +338,16 @@ void RotaryEncoder::setLongPressTime(unsigned long longPress)
   longPressTime = longPress; 
 }
 
+void RotaryEncoder::setDoubleClickTime(unsigned int ms)
+{
+  doubleClickTime = ms;
+}
+
+void RotaryEncoder::setRepeatInterval(unsigned int ms)
+{
+  repeatInterval = ms;
+}
+
 bool RotaryEncoder::keyPressed() 
 {
     return switchPressed; 
@@ -265,45 +366,153 @@ void RotaryEncoder::switchUpdate()
 // We may come here either by an ISR caused by a rising or falling edge
 // or during polling
 {
-  bool pinState = digitalRead(pinSwitch);
- 
+  switchDecode(digitalRead(pinSwitch));
+}
+
+void RotaryEncoder::switchDecode(bool pinState)
+{
+  // One timestamp per call, and at most one sample per millisecond
+  unsigned long now = millis();
+  uint8_t elapsed = (uint8_t)now - lastSampleTick;
+  if (!elapsed)
+    return;
+  lastSampleTick = (uint8_t)now;
+
   // Apply the ON/OFF logic so that logic in the code below 1 is always true
   pinState ^= switchLogic; 
 
-  if (switchPressed) {
+  // Integrator: moves towards the input by the time elapsed and the state
+  // only flips at either end, so bounce shorter than debounceDelay is lost
+  uint8_t limit = (debounceDelay > 255) ? 255 : (debounceDelay ? debounceDelay : 1);
+  if (pinState)
+    switchIntegrator = ((unsigned int)switchIntegrator + elapsed >= limit) ? limit : switchIntegrator + elapsed;
+  else
+    switchIntegrator = (elapsed >= switchIntegrator) ? 0 : switchIntegrator - elapsed;
 
-    if ((millis() - lastPressedTime) > longPressTime) {
-      switchLongPress = true;
+  if (!switchPressed) {
+    if (switchIntegrator == limit) {
+      switchPressed = true; 
+      lastPressedTime = now;
+      pushEvent(EV_PRESS);
+      secondPress = clickPending && ((now - lastReleaseTime) <= doubleClickTime);
+      clickPending = false;
+    } else if (clickPending && ((now - lastReleaseTime) > doubleClickTime)) {
+      clickPending = false;
+      switchEvent(EV_CLICK);
     }
-
-    if ((millis() - lastPressedTime) > debounceDelay) {
-      // Debouncing period finished, so state is the current state of the switch
-      // which we consider as stable.
-      // We also consider that the debouncing period is smaller than the time between 
-      // consecutive switch presses
-      if (!pinState) {
-        switchPressed = false;
-        switchLongPress = false;
-        lastPressedTime = 0;
-      } 
+  } else if (switchIntegrator == 0) {
+    switchPressed = false;
+    pushEvent(EV_RELEASE);
+    // a long press is not also a click
+    if (!switchLongPress) {
+      if (secondPress)
+        switchEvent(EV_DOUBLE_CLICK);
+      else if (!doubleClickTime)
+        switchEvent(EV_CLICK);
+      else {
+        clickPending = true;
+        lastReleaseTime = now;
+      }
     }
-  } else {
-    if (pinState) {
-      // New period when switch is considered as pressed
-      switchPressed = true; 
-      lastPressedTime = millis();
-    } else {
-      switchPressed = false;
-      switchLongPress = false; 
-      lastPressedTime = 0; 
-    } 
+    switchLongPress = false;
+    secondPress = false;
+    lastPressedTime = 0;
+  } else if (!switchLongPress) {
+    if ((now - lastPressedTime) > longPressTime) {
+      switchLongPress = true;
+      secondPress = false;
+      nextRepeatTime = now + repeatInterval;
+      switchEvent(EV_LONG_PRESS);
+    }
+  } else if (repeatInterval && ((long)(now - nextRepeatTime) >= 0)) {
+    nextRepeatTime += repeatInterval;
+    switchEvent(EV_REPEAT);
   }
 }
 
+void RotaryEncoder::switchEvent(uint8_t type)
+{
+  lastSwitchEvent = type;
+  pushEvent(type);
+}
+
+uint8_t RotaryEncoder::getSwitchEvent()
+{
+  uint8_t type = lastSwitchEvent;
+  lastSwitchEvent = EV_NONE;
+  return type;
+}
+
 void RotaryEncoder::update()
 {
-  rotaryUpdate();
+  if (!interruptMode)
+    rotaryUpdate();
   switchUpdate();
 }
 
+// ----- Event queue -----
+
+bool RotaryEncoder::enableEvents()
+{
+  if (events)
+    return true;
+  RotaryEvent *e = (RotaryEvent *)malloc(ROTARY_EVENT_QUEUE_SIZE * sizeof(RotaryEvent));
+  if (!e)
+    return false;
+  ROTARY_ATOMIC {
+    eventHead = eventTail = eventLost = 0;
+    events = e;
+  }
+  return true;
+}
+
+void RotaryEncoder::disableEvents()
+{
+  RotaryEvent *e = events;
+  ROTARY_ATOMIC {
+    events = NULL;
+  }
+  free(e);
+}
+
+// Called from the ISR for counts and from loop() for the switch. An AVR ISR
+// is never interrupted, the block only matters on the loop() side.
+void RotaryEncoder::pushEvent(uint8_t type)
+{
+  if (!events)
+    return;
+  unsigned long now = micros();
+  ROTARY_ATOMIC {
+    uint8_t head = eventHead;
+    uint8_t next = (head + 1) & (ROTARY_EVENT_QUEUE_SIZE - 1);
+    if (next == eventTail) {
+      if (eventLost < 255)
+        eventLost++;
+    } else {
+      events[head].type = type;
+      events[head].position = rotaryPosition;
+      events[head].time = now;
+      // publish only after the slot is written
+      eventHead = next;
+    }
+  }
+}
+
+// The consumer only moves the tail and needs no lock
+bool RotaryEncoder::getEvent(RotaryEvent &event)
+{
+  uint8_t tail = eventTail;
+  if (!events || (tail == eventHead))
+    return false;
+  // the slot must not be read before the head
+  __asm__ __volatile__ ("" ::: "memory");
+  event = events[tail];
+  eventTail = (tail + 1) & (ROTARY_EVENT_QUEUE_SIZE - 1);
+  return true;
+}
+
+uint8_t RotaryEncoder::eventsLost()
+{
+  return eventLost;
+}
 
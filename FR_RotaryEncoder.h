@@ -60,7 +60,7 @@
 
 // Sets the sensitivity of rotation
 //   false Two clicks are required per count
-//   true  One click is required per count (with first-click problem)
+//   true  One click is required per count
 #define DEFAULT_SENSITIVITY false 
 
 // Boolean logic of the switch wiring
@@ -69,15 +69,42 @@
 // Usually, pull-up resistors are used and idle state is 1, so false must be set
 #define DEFAULT_SWITCH_LOGIC false
 
-// In milliseconds. Can be changed with setDebounceDelay()
+// In milliseconds, at most 255. Can be changed with setDebounceDelay()
+// The time the switch input must be stable before the state changes.
 // For the switch only. Not used for rotary.
-#define DEFAULT_DEBOUNCE_DELAY 100
+#define DEFAULT_DEBOUNCE_DELAY 10
 
 // In milliseconds. Can be changed with setLongPressTime()
 #define DEFAULT_LONG_PRESS_TIME 700
 
+// In milliseconds. Can be changed with setDoubleClickTime()
+// A second press within this time after a release is a double click.
+#define DEFAULT_DOUBLE_CLICK_TIME 250
+
+// In milliseconds. Can be changed with setRepeatInterval()
+// While held after a long press, EV_REPEAT comes at this interval.
+#define DEFAULT_REPEAT_INTERVAL 150
+
+// Velocity acceleration, in milliseconds between counts. Can be set with
+// setAcceleration(). Slower than SLOW moves by the rotational step, FAST
+// or quicker by the full factor.
+#define DEFAULT_ACCEL_SLOW_TIME 100
+#define DEFAULT_ACCEL_FAST_TIME 10
+
+// Event queue length, a power of two. Allocated by enableEvents()
+#ifndef ROTARY_EVENT_QUEUE_SIZE
+#define ROTARY_EVENT_QUEUE_SIZE 16
+#endif
+
 //==========================================================================
 
+// One input event, see RotaryEncoder::getEvent()
+struct RotaryEvent {
+    uint8_t type;          // RotaryEncoder::EventType
+    int position;          // position after the event
+    unsigned long time;    // micros() when it was detected
+};
+
 class RotaryEncoder
 {
 public:
@@ -97,6 +124,18 @@ public:
       SW_LONG = 2
     };
 
+    enum EventType {
+      EV_NONE       = 0,
+      EV_CW         = 1,  // one count clockwise, also at a limit
+      EV_CCW        = 2,
+      EV_PRESS      = 3,
+      EV_RELEASE    = 4,
+      EV_LONG_PRESS = 5,
+      EV_CLICK      = 6,  // released before a long press, no second press
+      EV_DOUBLE_CLICK = 7,
+      EV_REPEAT     = 8   // held after a long press
+    };
+
     // Sets the limits of the rotary encoder, as well as the wrap mode
     void setRotaryLimits(int rotaryMin, int rotaryMax, bool rotaryWrapMode);
 
@@ -133,16 +172,34 @@ public:
 
     // Sets the sensitivity of rotation
     // false (default): Requires two clicks per transition
-    // true: Requires one click per transition (except the first after setup 
-    // which depends on the initial switch position) 
+    // true: Requires one click per transition
     void setSensitive(bool fast);
 
     // Sets the step that position changes in every transition
     void setRotationalStep(int step);
 
+    // Sets the velocity acceleration of the step.
+    // Counts closer than slowTime ms apart move by more than the rotational
+    // step, up to maxFactor times the step at fastTime ms or less.
+    // A change of direction starts again from a single step.
+    // maxFactor 1 (default) turns acceleration off.
+    void setAcceleration(uint8_t maxFactor,
+                         unsigned int slowTime = DEFAULT_ACCEL_SLOW_TIME,
+                         unsigned int fastTime = DEFAULT_ACCEL_FAST_TIME);
+
     // Updates only the encoder state.
+    // Can be called either from loop or from the pin-change interrupt.
     void rotaryUpdate();
 
+    // Interrupt mode: enables the pin-change interrupts of both rotary pins.
+    // The sketch owns the vector and calls rotaryUpdate() from it, e.g. for
+    // pins 8 and 9 on a Nano:
+    //   ISR(PCINT0_vect) { Encoder.rotaryUpdate(); }
+    // update() then only polls the switch.
+    // Returns false if a pin has no pin-change interrupt.
+    bool enableInterrupts();
+    void disableInterrupts();
+
     // Switch
 
     // Enable internal pullup resistor for the switch
@@ -153,7 +210,7 @@ public:
     //  false means: switch OFF if pin is 1, ON if pin is 0
     void setSwitchLogic(bool logic);
 
-    // Sets the switch debouncing time in milliseconds
+    // Sets the switch debouncing time in milliseconds, at most 255
     void setSwitchDebounceDelay(unsigned long dd);
 
     // Returns the state of the switch
@@ -166,6 +223,19 @@ public:
     // Set the minimum time after which a switch press is considered a Long Press
     void setLongPressTime(unsigned long longPress);
 
+    // Sets the double click window in milliseconds.
+    // 0 turns double clicks off and reports EV_CLICK right at the release,
+    // otherwise a single click is reported once the window has passed.
+    void setDoubleClickTime(unsigned int ms);
+
+    // Sets the repeat interval while held after a long press, 0 turns it off
+    void setRepeatInterval(unsigned int ms);
+
+    // Returns the last click class event and clears it
+    //   EV_NONE, EV_CLICK, EV_DOUBLE_CLICK, EV_LONG_PRESS or EV_REPEAT
+    // All of them also go to the event queue, see enableEvents().
+    uint8_t getSwitchEvent();
+
     // Returns true while switch is pressed
     bool keyPressed();
 
@@ -179,19 +249,51 @@ public:
     // Updates only the switch state.
     void switchUpdate();
 
-    
+    // Event queue
+    // Every count and switch change is queued with its micros() timestamp,
+    // so nothing is lost when loop() is slow. The ISR and update() produce,
+    // the sketch drains with getEvent(). The positions and switch states
+    // above keep working.
+    // Returns false if the queue cannot be allocated.
+    bool enableEvents();
+    void disableEvents();
+
+    // Takes the oldest event, returns false if there is none
+    bool getEvent(RotaryEvent &event);
+
+    // Events dropped because the queue was full
+    uint8_t eventsLost();
+
+
+protected:
+    // Feeds one sample of the rotary pins, state = A * 2 + B
+    void rotaryDecode(uint8_t state);
+    // Feeds one sample of the switch pin, before the switch logic
+    void switchDecode(bool pinState);
+    bool interruptMode = false;
+
 private:
 	
     // Rotary	
 	int pinA, pinB;  // Pins used for the rotary encoder.     
     void changeRotaryValue(bool up);
+    int acceleratedStep(bool sameDirection);
+    void pushEvent(uint8_t type);
+    void switchEvent(uint8_t type);
+
+    // Event ring, written at the head by the producer and read at the tail
+    RotaryEvent *events = NULL;
+    volatile uint8_t eventHead = 0;
+    volatile uint8_t eventTail = 0;
+    volatile uint8_t eventLost = 0;
+    bool pinChange(bool enable);
 
     // Set in the interrupt service routine and therefore
     // should be volatile
 	volatile int direction = NOT_MOVED;
 	volatile int rotaryPosition = 0; 
-	volatile int a0 = ROTARY_POSITION_UNKNOWN;
-	volatile int b0 = ROTARY_POSITION_UNKNOWN;
+	volatile uint8_t rotaryState = 0;   // last A * 2 + B
+	volatile int8_t quarterSteps = 0;   // valid transitions not yet counted
 
     // Switch
     int pinSwitch;   // Pin used for the switch
@@ -199,6 +301,13 @@ private:
     volatile bool switchPressed = false; 
     volatile bool switchLongPress = false;
     volatile unsigned long lastPressedTime = 0;  // the last time the switch has been pressed
+    uint8_t switchIntegrator = 0;    // ms the input was on, less the ms it was off
+    uint8_t lastSampleTick = 0;      // low byte of millis() at the last sample
+    bool clickPending = false;       // released, waiting for a second press
+    bool secondPress = false;
+    unsigned long lastReleaseTime = 0;
+    unsigned long nextRepeatTime = 0;
+    volatile uint8_t lastSwitchEvent = EV_NONE;
 
     /*
      I hate to write get methods for each one of the following.
@@ -213,10 +322,83 @@ private:
 	bool wrapMode = DEFAULT_WRAP_MODE; 
     bool sensitive = DEFAULT_SENSITIVITY; // Two clicks per count
     int rotationalStep = 1; // Position changes by 1. Can be set with setRotationalStep
+    uint8_t accelFactor = 1; // No acceleration. Can be set with setAcceleration
+    unsigned int accelSlow = DEFAULT_ACCEL_SLOW_TIME;
+    unsigned int accelFast = DEFAULT_ACCEL_FAST_TIME;
+    volatile unsigned long lastCountTime = 0;
     // Switch
     unsigned long debounceDelay = DEFAULT_DEBOUNCE_DELAY; // Increase if the output bounces flickers        
     unsigned long longPressTime = DEFAULT_LONG_PRESS_TIME; // Time for the switch to be pressed so as to be considered a long press (milliseconds) 
+    unsigned int doubleClickTime = DEFAULT_DOUBLE_CLICK_TIME;
+    unsigned int repeatInterval = DEFAULT_REPEAT_INTERVAL;
 
     
 };
+
+//==========================================================================
+// RotaryEncoderT<CLK, DT, SW>
+//
+// The same encoder with the pins fixed at compile time, e.g.
+//   RotaryEncoderT<8, 9, 7> Encoder;
+// On the ATmega328P/168 (Uno, Nano, Pro Mini) each pin is resolved to its
+// PINx register and bit mask at compile time, and update() reads every port
+// in use once instead of calling digitalRead() three times. rotaryUpdate()
+// is a single port read when CLK and DT share a port, which keeps the
+// pin-change ISR short. Other boards use digitalRead().
+//
+// update(), rotaryUpdate() and switchUpdate() hide the RotaryEncoder ones,
+// call them on the RotaryEncoderT object.
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || \
+    defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__)
+  #define ROTARY_DIRECT_PORTS
+#endif
+
+template <uint8_t CLK, uint8_t DT, uint8_t SW>
+class RotaryEncoderT : public RotaryEncoder
+{
+public:
+    RotaryEncoderT() : RotaryEncoder(CLK, DT, SW) {}
+
+#if defined(ROTARY_DIRECT_PORTS)
+    static_assert((CLK < 20) && (DT < 20) && (SW < 20), "pin is not on port B, C or D");
+
+    void rotaryUpdate() {
+      uint8_t a = readPort(portOf(CLK));
+      uint8_t b = (portOf(DT) == portOf(CLK)) ? a : readPort(portOf(DT));
+      rotaryDecode(rotaryState(a, b));
+    }
+
+    void switchUpdate() {
+      switchDecode(readPort(portOf(SW)) & maskOf(SW));
+    }
+
+    void update() {
+      uint8_t a = readPort(portOf(CLK));
+      uint8_t b = (portOf(DT) == portOf(CLK)) ? a : readPort(portOf(DT));
+      uint8_t s = (portOf(SW) == portOf(CLK)) ? a :
+                  (portOf(SW) == portOf(DT)) ? b : readPort(portOf(SW));
+      if (!interruptMode)
+        rotaryDecode(rotaryState(a, b));
+      switchDecode(s & maskOf(SW));
+    }
+
+private:
+    // Arduino pin numbering: 0-7 PORTD, 8-13 PORTB, 14-19 (A0-A5) PORTC
+    static constexpr uint8_t portOf(uint8_t pin) {
+      return (pin < 8) ? 0 : ((pin < 14) ? 1 : 2);
+    }
+    static constexpr uint8_t maskOf(uint8_t pin) {
+      return 1 << ((pin < 8) ? pin : ((pin < 14) ? pin - 8 : pin - 14));
+    }
+    // port is a constant, only the matching register is read
+    static inline uint8_t readPort(uint8_t port) __attribute__((always_inline)) {
+      return (port == 0) ? PIND : ((port == 1) ? PINB : PINC);
+    }
+    static inline uint8_t rotaryState(uint8_t a, uint8_t b) {
+      return ((a & maskOf(CLK)) ? 2 : 0) | ((b & maskOf(DT)) ? 1 : 0);
+    }
+#endif
+};
+
 #endif
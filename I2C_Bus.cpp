@@ -0,0 +1,349 @@
+#include "I2C_Bus.h"
+
+#include <string.h>
+
+#if defined (__AVR_ATtiny84__) || defined(__AVR_ATtiny85__) || (__AVR_ATtiny2313__)
+#include "TinyWireM.h"
+#define Wire TinyWireM
+#else
+#include <Wire.h>
+#endif
+#if defined(ARDUINO) && (ARDUINO >= 100) //scl
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+I2C_Bus I2CBus;
+
+static inline void wiresend(uint8_t x) {
+#if ARDUINO >= 100
+  Wire.write((uint8_t)x);
+#else
+  Wire.send(x);
+#endif
+}
+
+static inline uint8_t wirerecv(void) {
+#if ARDUINO >= 100
+  return Wire.read();
+#else
+  return Wire.receive();
+#endif
+}
+
+/*********** statistics */
+uint16_t I2C_Stats::latencyAvg() const {
+  uint32_t done = 0;
+  for (uint8_t i = 0; i < I2C_HIST_BINS; i++) done += latencyHist[i];
+  return done ? latencySum / done : 0;
+}
+
+void I2C_Stats::reset() {
+  memset(this, 0, sizeof(*this));
+  latencyMin = 0xFFFF;
+}
+
+void I2C_Bus::record(I2C_Stats *stats, uint8_t status, uint8_t bytes, unsigned long start) {
+  if (!stats) return;
+  unsigned long us = micros() - start;
+  stats->transactions++;
+  stats->bytes += bytes;
+  if ((status == I2C_NACK_ADDR) || (status == I2C_NACK_DATA) || (status == I2C_SHORT_READ)) stats->nacks++;
+  if (status != I2C_OK) return;
+
+  if (us > 0xFFFF) us = 0xFFFF;
+  if (us < stats->latencyMin) stats->latencyMin = us;
+  if (us > stats->latencyMax) stats->latencyMax = us;
+  stats->latencySum += us;
+  uint8_t bin = 0;
+  for (us >>= I2C_HIST_SHIFT; us && (bin < I2C_HIST_BINS - 1); us >>= 1) bin++;
+  stats->latencyHist[bin]++;
+}
+
+/*********** transport */
+I2C_Bus::I2C_Bus() {
+  init(true);
+}
+
+I2C_Bus::I2C_Bus(bool twi) {
+  init(twi);
+}
+
+void I2C_Bus::init(bool twi) {
+  _twi = twi;
+  _retries = I2C_DEFAULT_RETRIES;
+  _timeout = I2C_DEFAULT_TIMEOUT_US;
+  _head = _tail = NULL;
+  _step = 0;
+}
+
+void I2C_Bus::begin() {
+  Wire.begin();
+#if defined(WIRE_HAS_TIMEOUT)
+  Wire.setWireTimeout(_timeout, true);
+#endif
+}
+
+void I2C_Bus::setRetries(uint8_t retries) {
+  _retries = retries;
+}
+
+void I2C_Bus::setTimeout(uint16_t us) {
+  _timeout = us;
+#if defined(WIRE_HAS_TIMEOUT)
+  Wire.setWireTimeout(_timeout, true);
+#endif
+}
+
+uint8_t I2C_Bus::transmit(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len) {
+  Wire.beginTransmission(addr);
+  wiresend(reg);
+  for (uint8_t i = 0; i < len; i++) wiresend(buf[i]);
+  return Wire.endTransmission();
+}
+
+uint8_t I2C_Bus::receive(uint8_t addr, uint8_t *buf, uint8_t len) {
+  Wire.requestFrom(addr, len);
+  uint8_t n = Wire.available();
+  for (uint8_t i = 0; i < len; i++) buf[i] = (i < n) ? wirerecv() : 0;
+  return n;
+}
+
+// returns non-zero if the transaction should be tried again
+uint8_t I2C_Bus::retry(uint8_t status, uint8_t attempt, I2C_Stats *stats) {
+  if (status == I2C_OK) return 0;
+  if (attempt >= _retries) {
+    if (stats) stats->failures++;
+    return 0;
+  }
+  if (stats) stats->retries++;
+  // a NACK is the device's answer, anything else may be a bus held low
+  if ((status == I2C_ERROR) || (status == I2C_TIMEOUT)) recover(stats);
+  return 1;
+}
+
+uint8_t I2C_Bus::write(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len, I2C_Stats *stats) {
+  flush();
+  return writeNow(addr, reg, buf, len, stats);
+}
+
+uint8_t I2C_Bus::writeNow(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len, I2C_Stats *stats) {
+  uint8_t status;
+  for (uint8_t attempt = 0; ; attempt++) {
+    unsigned long start = micros();
+    status = transmit(addr, reg, buf, len);
+    record(stats, status, 2 + len, start);
+    if (!retry(status, attempt, stats)) break;
+  }
+  return status;
+}
+
+uint8_t I2C_Bus::read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len, I2C_Stats *stats) {
+  flush();
+  return readNow(addr, reg, buf, len, stats);
+}
+
+uint8_t I2C_Bus::readNow(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len, I2C_Stats *stats) {
+  uint8_t status;
+  for (uint8_t attempt = 0; ; attempt++) {
+    unsigned long start = micros();
+    status = transmit(addr, reg, NULL, 0);
+    if ((status == I2C_OK) && (receive(addr, buf, len) < len)) status = I2C_SHORT_READ;
+    record(stats, status, 3 + len, start);
+    if (!retry(status, attempt, stats)) break;
+  }
+  return status;
+}
+
+uint8_t I2C_Bus::writeRegister(uint8_t addr, uint8_t reg, uint8_t value, I2C_Stats *stats) {
+  return write(addr, reg, &value, 1, stats);
+}
+
+uint8_t I2C_Bus::readRegister(uint8_t addr, uint8_t reg, I2C_Stats *stats) {
+  uint8_t value = 0;
+  read(addr, reg, &value, 1, stats);
+  return value;
+}
+
+/*********** queue */
+bool I2C_Bus::submit(I2C_Request &req) {
+  if (req.status == I2C_PENDING) return false;
+  req.status = I2C_PENDING;
+  req.next = NULL;
+  if (_tail) _tail->next = &req;
+  else _head = &req;
+  _tail = &req;
+  return true;
+}
+
+void I2C_Bus::flush() {
+  while (poll());
+}
+
+// the head request is done, for good or to be tried again
+void I2C_Bus::finish(uint8_t status) {
+  I2C_Request *r = _head;
+  record(r->stats, status, (r->read ? 3 : 2) + r->len, _start);
+  _step = 0;
+  if (retry(status, _attempt, r->stats)) {
+    _attempt++;
+    return;
+  }
+  _attempt = 0;
+  _head = r->next;
+  if (!_head) _tail = NULL;
+  r->status = status;
+}
+
+#if defined(TWCR) && defined(TWINT)
+
+// TWI status codes, TWSR with the prescaler bits masked
+#define TW_START       0x08
+#define TW_REP_START   0x10
+#define TW_MT_SLA_ACK  0x18
+#define TW_MT_SLA_NACK 0x20
+#define TW_MT_DATA_ACK 0x28
+#define TW_MT_DATA_NACK 0x30
+#define TW_ARB_LOST    0x38
+#define TW_MR_SLA_ACK  0x40
+#define TW_MR_SLA_NACK 0x48
+#define TW_MR_DATA_ACK 0x50
+#define TW_MR_DATA_NACK 0x58
+
+// _step of the head request
+#define STEP_IDLE    0  // not started
+#define STEP_WRITE   1  // address, register and data going out
+#define STEP_READ    2  // repeated START sent, reading
+#define STEP_STOP    3  // done, STOP going out
+
+#define TWCR_GO   (_BV(TWINT) | _BV(TWEN))
+
+// Each call handles what TWINT says the hardware is done with and leaves
+// the next byte on its way. The interrupt enable stays off, Wire's ISR
+// never sees these transactions.
+bool I2C_Bus::pollTwi() {
+  while (_head) {
+    I2C_Request *r = _head;
+    if ((_step == STEP_IDLE) || (_step == STEP_STOP)) {
+      if (TWCR & _BV(TWSTO)) return true; // the last STOP is still going out
+      if (_step == STEP_STOP) {
+        finish(I2C_OK);
+        continue;
+      }
+      _start = micros();
+      _index = 0;
+      _step = STEP_WRITE;
+      TWCR = TWCR_GO | _BV(TWSTA);
+      return true;
+    }
+    if (!(TWCR & _BV(TWINT))) {
+      if ((unsigned long)(micros() - _start) <= _timeout) return true;
+      recover(r->stats);
+      finish(I2C_TIMEOUT);
+      continue;
+    }
+
+    switch (TWSR & 0xF8) {
+      case TW_START:
+        TWDR = r->addr << 1;
+        TWCR = TWCR_GO;
+        break;
+      case TW_REP_START:
+        TWDR = (r->addr << 1) | 1;
+        TWCR = TWCR_GO;
+        break;
+      case TW_MT_SLA_ACK:
+        TWDR = r->reg;
+        TWCR = TWCR_GO;
+        break;
+      case TW_MT_DATA_ACK:
+        if (r->read) {
+          _step = STEP_READ;
+          TWCR = TWCR_GO | _BV(TWSTA);
+        } else if (_index < r->len) {
+          TWDR = r->buf[_index++];
+          TWCR = TWCR_GO;
+        } else {
+          _step = STEP_STOP;
+          TWCR = TWCR_GO | _BV(TWSTO);
+        }
+        break;
+      case TW_MR_DATA_ACK:
+        r->buf[_index++] = TWDR;
+        // fall through
+      case TW_MR_SLA_ACK:
+        // ACK all but the last byte
+        TWCR = TWCR_GO | ((r->len - _index > 1) ? _BV(TWEA) : 0);
+        break;
+      case TW_MR_DATA_NACK:
+        r->buf[_index++] = TWDR;
+        _step = STEP_STOP;
+        TWCR = TWCR_GO | _BV(TWSTO);
+        break;
+      case TW_ARB_LOST:
+        // the bus is someone else's, no STOP
+        TWCR = TWCR_GO;
+        finish(I2C_ERROR);
+        break;
+      default:
+        TWCR = TWCR_GO | _BV(TWSTO);
+        finish(((TWSR & 0xF8) == TW_MT_DATA_NACK) ? I2C_NACK_DATA :
+               (((TWSR & 0xF8) == TW_MT_SLA_NACK) || ((TWSR & 0xF8) == TW_MR_SLA_NACK)) ? I2C_NACK_ADDR : I2C_ERROR);
+        break;
+    }
+    return true;
+  }
+  return false;
+}
+
+#endif
+
+// without TWI registers to drive the head request runs through transmit()
+// and receive()
+bool I2C_Bus::poll() {
+#if defined(TWCR) && defined(TWINT)
+  if (_twi) return pollTwi();
+#endif
+  if (!_head) return false;
+  I2C_Request *r = _head;
+  _head = r->next;
+  if (!_head) _tail = NULL;
+  uint8_t status = r->read ? readNow(r->addr, r->reg, r->buf, r->len, r->stats)
+                           : writeNow(r->addr, r->reg, r->buf, r->len, r->stats);
+  r->status = status;
+  return _head != NULL;
+}
+
+bool I2C_Bus::recover(I2C_Stats *stats) {
+  if (stats) stats->recoveries++;
+// SDA and SCL are constants, not macros, on most cores; the variants
+// define the pin numbers
+#if defined(PIN_WIRE_SDA) && defined(PIN_WIRE_SCL)
+#if defined(TWCR)
+  TWCR = 0; // hand the pins back to the port registers
+#endif
+  pinMode(PIN_WIRE_SDA, INPUT_PULLUP);
+  pinMode(PIN_WIRE_SCL, INPUT_PULLUP);
+  // a slave in the middle of a byte lets go of SDA after at most nine clocks
+  for (uint8_t i = 0; (i < 9) && (digitalRead(PIN_WIRE_SDA) == LOW); i++) {
+    digitalWrite(PIN_WIRE_SCL, LOW);
+    pinMode(PIN_WIRE_SCL, OUTPUT);
+    delayMicroseconds(5);
+    pinMode(PIN_WIRE_SCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+  }
+  // STOP: SDA rises while SCL is high
+  digitalWrite(PIN_WIRE_SDA, LOW);
+  pinMode(PIN_WIRE_SDA, OUTPUT);
+  delayMicroseconds(5);
+  pinMode(PIN_WIRE_SDA, INPUT_PULLUP);
+  delayMicroseconds(5);
+  bool released = (digitalRead(PIN_WIRE_SDA) == HIGH) && (digitalRead(PIN_WIRE_SCL) == HIGH);
+  begin();
+  return released;
+#else
+  begin();
+  return true;
+#endif
+}
@@ -0,0 +1,156 @@
+#ifndef I2C_Bus_h
+#define I2C_Bus_h
+
+/*
+  I2C_Bus  bounded-retry I2C transport shared by LCD_I2C and Keypad_I2C
+
+  Every transaction is retried at most a configurable number of times
+  instead of spinning on Wire.endTransmission(), a stuck bus is recovered
+  by clocking out SCL, and each device keeps its own counters and latency
+  figures in an I2C_Stats the sketch can read.
+
+  Transactions can also be queued: submit() takes an I2C_Request and
+  returns at once, poll() moves the bus along and the request's status
+  turns from I2C_PENDING to the result when it is done. On AVR poll()
+  drives the TWI hardware itself, one step per TWINT, and never waits, so
+  the CPU is free while bytes are on the wire. The TWI interrupt belongs
+  to Wire, so poll() has to be called from loop() (LCD_I2C::poll() and
+  Keypad_I2C::getKey() do). Other cores run the request at the head of
+  the queue through Wire when polled. The blocking calls finish the queue
+  first, so both kinds can be mixed and run in submission order.
+
+  I2CBus is the Wire bus. Another transport (a second controller, software
+  I2C, a mock on the host) derives from I2C_Bus, constructs it with false
+  and overrides begin(), transmit(), receive() and recover(); retries,
+  statistics and the queue come with it. MCP23017, LCD_I2C and Keypad_I2C
+  take the bus as an optional constructor argument.
+*/
+
+#include <inttypes.h>
+#include <stddef.h>
+#if defined (__AVR_ATtiny84__) || defined(__AVR_ATtiny85__) || defined(__AVR_ATtiny2313__)
+#include "TinyWireM.h"
+#else
+#include "Wire.h"
+#endif
+
+// size of the Wire transmit buffer, register byte included: Wire has
+// BUFFER_LENGTH, TinyWireM on USI cores USI_BUF_SIZE
+#if defined(BUFFER_LENGTH)
+#define I2C_WIRE_BUFFER BUFFER_LENGTH
+#elif defined(USI_BUF_SIZE)
+#define I2C_WIRE_BUFFER USI_BUF_SIZE
+#else
+#define I2C_WIRE_BUFFER 32
+#endif
+
+#define I2C_DEFAULT_RETRIES    3
+#define I2C_DEFAULT_TIMEOUT_US 25000  // per transaction, needs WIRE_HAS_TIMEOUT
+
+// status codes, 0..5 are the ones Wire.endTransmission() returns
+#define I2C_OK          0
+#define I2C_TOO_LONG    1  // data too long to fit in transmit buffer
+#define I2C_NACK_ADDR   2  // received NACK on transmit of address
+#define I2C_NACK_DATA   3  // received NACK on transmit of data
+#define I2C_ERROR       4  // other error, e.g. lost arbitration
+#define I2C_TIMEOUT     5
+#define I2C_SHORT_READ  6  // device returned fewer bytes than requested
+#define I2C_PENDING     0xFF // queued or on the bus
+
+// latency histogram: bin 0 counts transactions under 128us, every further
+// bin doubles the limit, the last one takes everything above 8ms
+#define I2C_HIST_BINS  8
+#define I2C_HIST_SHIFT 7
+
+struct I2C_Stats {
+	uint32_t transactions; // attempts, retries included
+	uint32_t bytes;        // bytes on the bus, address and register included
+	uint16_t nacks;
+	uint16_t retries;
+	uint16_t failures;     // transactions given up after the retry budget
+	uint16_t recoveries;   // stuck bus recoveries
+	uint16_t latencyMin;   // us, completed transactions only
+	uint16_t latencyMax;
+	uint32_t latencySum;
+	uint16_t latencyHist[I2C_HIST_BINS];
+
+	I2C_Stats() { reset(); }
+	uint16_t latencyAvg() const;
+	void reset();
+};
+
+// A queued transaction: len bytes from buf written to register reg, or
+// read from it into buf. buf stays the caller's until status is set.
+struct I2C_Request {
+	uint8_t addr;
+	uint8_t reg;
+	uint8_t *buf;
+	uint8_t len;
+	bool read;
+	volatile uint8_t status;  // I2C_PENDING until done
+	I2C_Stats *stats;
+	I2C_Request *next;        // queue link, owned by I2C_Bus
+
+	void set(uint8_t address, uint8_t r, uint8_t *data, uint8_t n, bool isRead, I2C_Stats *s = NULL) {
+		addr = address; reg = r; buf = data; len = n; read = isRead; stats = s; status = I2C_OK;
+	}
+	bool done() const { return status != I2C_PENDING; }
+};
+
+class I2C_Bus {
+public:
+	I2C_Bus();
+	virtual ~I2C_Bus() {}
+	virtual void begin();
+	// extra attempts after a failed transaction
+	void setRetries(uint8_t retries);
+	// Wire timeout, only effective on cores that define WIRE_HAS_TIMEOUT
+	void setTimeout(uint16_t us);
+
+	// write len bytes starting at register reg
+	uint8_t write(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len, I2C_Stats *stats = NULL);
+	// read len bytes starting at register reg
+	uint8_t read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len, I2C_Stats *stats = NULL);
+	uint8_t writeRegister(uint8_t addr, uint8_t reg, uint8_t value, I2C_Stats *stats = NULL);
+	uint8_t readRegister(uint8_t addr, uint8_t reg, I2C_Stats *stats = NULL);
+
+	// frees a slave that holds SDA low: up to nine SCL pulses and a STOP
+	virtual bool recover(I2C_Stats *stats = NULL);
+
+	// queues a request, false if it is already queued
+	bool submit(I2C_Request &req);
+	// moves the queue along without waiting, true while requests are left
+	bool poll();
+	// waits until the queue is empty
+	void flush();
+
+protected:
+	// twi: poll() may drive the TWI registers, true only for the Wire bus
+	I2C_Bus(bool twi);
+	// reg followed by len bytes in one write transaction, returns a status
+	virtual uint8_t transmit(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len);
+	// len bytes read from the device, returns how many arrived
+	virtual uint8_t receive(uint8_t addr, uint8_t *buf, uint8_t len);
+	uint16_t _timeout;
+
+private:
+	void init(bool twi);
+	bool pollTwi();
+	uint8_t writeNow(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t len, I2C_Stats *stats);
+	uint8_t readNow(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len, I2C_Stats *stats);
+	void finish(uint8_t status);
+	uint8_t retry(uint8_t status, uint8_t attempt, I2C_Stats *stats);
+	void record(I2C_Stats *stats, uint8_t status, uint8_t bytes, unsigned long start);
+	uint8_t _retries;
+	bool _twi;
+	// queue
+	I2C_Request *_head, *_tail;
+	uint8_t _step;            // of the request at the head, see I2C_Bus.cpp
+	uint8_t _index;           // data bytes done
+	uint8_t _attempt;
+	unsigned long _start;     // micros() the attempt started
+};
+
+extern I2C_Bus I2CBus;
+
+#endif // I2C_Bus_h
@@ -0,0 +1,158 @@
+#include "I2C_Scheduler.h"
+
+#if defined(ARDUINO) && (ARDUINO >= 100)
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#define KEY_MASK (I2C_SCHEDULER_KEYS - 1)
+
+static inline uint16_t cap16(unsigned long us) {
+	return (us > 0xFFFF) ? 0xFFFF : us;
+}
+
+I2C_Scheduler::I2C_Scheduler() {
+	_count = 0;
+	_next = 0;
+	_scanUs = I2C_SCHEDULER_SCAN_MS * 1000UL;
+}
+
+int8_t I2C_Scheduler::addStation(LCD_I2C *lcd, Keypad_I2C *keypad, uint8_t priority) {
+	if ((_count >= I2C_SCHEDULER_STATIONS) || (!lcd && !keypad)) return -1;
+	if (lcd && !lcd->enableAsync()) return -1;
+	Station &s = _stations[_count];
+	s.lcd = lcd;
+	s.keypad = keypad;
+	s.priority = priority;
+	s.keyHead = s.keyTail = 0;
+	// spread the scans over the interval
+	s.scanDue = micros() + _count * (_scanUs / I2C_SCHEDULER_STATIONS);
+	int8_t id = _count++;
+	resetStats(id);
+	return id;
+}
+
+void I2C_Scheduler::setScanInterval(uint16_t ms) {
+	_scanUs = ms ? ms * 1000UL : 1000UL;
+}
+
+// station ids in the order they get the bus: priority first, then turns
+// starting after the station that had the last one
+uint8_t I2C_Scheduler::order(uint8_t *ids) {
+	for (uint8_t i = 0; i < _count; i++) {
+		uint8_t id = (_next + i) % _count;
+		uint8_t j = i;
+		for (; (j > 0) && (_stations[ids[j - 1]].priority < _stations[id].priority); j--) ids[j] = ids[j - 1];
+		ids[j] = id;
+	}
+	return _count;
+}
+
+bool I2C_Scheduler::run() {
+	uint8_t ids[I2C_SCHEDULER_STATIONS];
+	uint8_t n = order(ids);
+	unsigned long now = micros();
+	for (uint8_t i = 0; i < n; i++) {
+		if (!scan(_stations[ids[i]], now)) continue;
+		_next = ids[i] + 1;
+		return true;
+	}
+	for (uint8_t i = 0; i < n; i++) {
+		if (!display(_stations[ids[i]])) continue;
+		_next = ids[i] + 1;
+		return true;
+	}
+	// idle: latch writes an expander is still combining go out now
+	return MCP23017::flushAll();
+}
+
+bool I2C_Scheduler::scan(Station &s, unsigned long now) {
+	if (!s.keypad) return false;
+	long late = (long)(now - s.scanDue);
+	if (late < 0) return false;
+	// keep the phase, but drop the intervals already missed
+	if ((unsigned long)late >= _scanUs) s.scanDue += _scanUs * ((unsigned long)late / _scanUs);
+	s.scanDue += _scanUs;
+
+	unsigned long start = micros();
+	char key = s.keypad->getKey();
+	if (key != NO_KEY) {
+		uint8_t head = (s.keyHead + 1) & KEY_MASK;
+		if (head == s.keyTail) s.stats.keysLost++;
+		else {
+			s.keys[s.keyHead] = key;
+			s.keyHead = head;
+		}
+	}
+	s.stats.scans++;
+	if (cap16(late) > s.stats.scanLateMax) s.stats.scanLateMax = cap16(late);
+	account(s, start);
+	return true;
+}
+
+// true if the display put a transaction on the bus; an entry still
+// waiting for the HD44780 gives the turn to the next station. poll()
+// takes entries off the queue only to send them, the bytes show up in
+// the expander's stats when the bus is done with them.
+bool I2C_Scheduler::display(Station &s) {
+	if (!s.lcd) return false;
+	unsigned long start = micros();
+	s.lcd->flush();
+	uint8_t room = s.lcd->queueRoom();
+	s.lcd->poll();
+	if (s.lcd->queueRoom() == room) return false;
+	account(s, start);
+	return true;
+}
+
+// the display and keypad of a station usually share one expander
+uint32_t I2C_Scheduler::busBytes(Station &s) {
+	I2C_Stats *lcd = s.lcd ? &s.lcd->getStats() : NULL;
+	I2C_Stats *keypad = s.keypad ? &s.keypad->getStats() : NULL;
+	uint32_t bytes = lcd ? lcd->bytes : 0;
+	if (keypad && (keypad != lcd)) bytes += keypad->bytes;
+	return bytes;
+}
+
+void I2C_Scheduler::account(Station &s, unsigned long start) {
+	s.stats.turns++;
+	s.stats.busyUs += micros() - start;
+}
+
+char I2C_Scheduler::getKey(int8_t station) {
+	if ((station < 0) || (station >= _count)) return NO_KEY;
+	Station &s = _stations[station];
+	if (s.keyHead == s.keyTail) return NO_KEY;
+	char key = s.keys[s.keyTail];
+	s.keyTail = (s.keyTail + 1) & KEY_MASK;
+	return key;
+}
+
+Station_Stats &I2C_Scheduler::getStats(int8_t station) {
+	if ((station < 0) || (station >= _count)) station = 0;
+	Station &s = _stations[station];
+	// whatever the bus finished since, also outside the station's turns
+	if (_count) s.stats.bytes = busBytes(s) - s.bytes0;
+	return s.stats;
+}
+
+uint32_t I2C_Scheduler::throughput(int8_t station) {
+	if ((station < 0) || (station >= _count)) return 0;
+	Station &s = _stations[station];
+	unsigned long ms = (micros() - s.since) / 1000;
+	if (!ms) return 0;
+	// in 32 bits, a 64-bit divide is a lot of flash for one figure; past
+	// 4 MB whole seconds are precise enough
+	uint32_t bytes = getStats(station).bytes;
+	if (bytes <= 0xFFFFFFFFUL / 1000) return bytes * 1000 / ms;
+	return (ms < 1000) ? bytes : bytes / (ms / 1000);
+}
+
+void I2C_Scheduler::resetStats(int8_t station) {
+	if ((station < 0) || (station >= _count)) return;
+	Station &s = _stations[station];
+	s.stats.reset();
+	s.since = micros();
+	s.bytes0 = busBytes(s);
+}
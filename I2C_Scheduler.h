@@ -0,0 +1,92 @@
+#ifndef I2C_Scheduler_h
+#define I2C_Scheduler_h
+
+/*
+  I2C_Scheduler  shares one bus between several boards
+
+  Up to eight boards (expander addresses 0x20-0x27) on one controller,
+  each a station with its display, its keypad or both. run() hands the
+  bus to one station for one unit of work and returns:
+    - a keypad scan, once the scan interval has passed
+    - otherwise one display transaction: what flush() queued for the
+      framebuffer, or anything else printed in asynchronous mode
+    - otherwise the latch writes of expanders in write combining mode
+  Due scans go before display traffic, higher priority stations before
+  lower ones, and stations of equal priority take turns, so a long redraw
+  on one board no longer holds up another board's keypad. loop() is just
+    bus.run();
+
+  Keys are buffered per station until getKey() collects them. Every
+  station counts its turns, bus bytes and time, and how late its scans
+  came; throughput() turns that into bytes per second.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+#include "LCD_I2C.h"
+#include "Keypad_I2C.h"
+
+#ifndef I2C_SCHEDULER_STATIONS
+#define I2C_SCHEDULER_STATIONS 8
+#endif
+#define I2C_SCHEDULER_KEYS 4        // keys buffered per station, a power of 2
+#define I2C_SCHEDULER_SCAN_MS 20    // default keypad scan interval
+
+struct Station_Stats {
+	uint32_t turns;        // turns that put a transaction on the bus
+	uint32_t bytes;        // bus bytes of the station's expanders, address included
+	uint32_t busyUs;       // time spent in those turns
+	uint32_t scans;
+	uint16_t scanLateMax;  // us a due scan waited, capped at 65535
+	uint16_t keysLost;     // keys not collected in time
+
+	Station_Stats() { reset(); }
+	void reset() { memset(this, 0, sizeof(*this)); }
+};
+
+class I2C_Scheduler {
+public:
+	I2C_Scheduler();
+
+	// Adds a board, lcd or keypad may be NULL. Puts the display into
+	// asynchronous mode. Returns the station id or -1.
+	int8_t addStation(LCD_I2C *lcd, Keypad_I2C *keypad, uint8_t priority = 0);
+	void setScanInterval(uint16_t ms);
+
+	// One unit of bus work, returns false if no station had any
+	bool run();
+
+	// next key pressed on a station's keypad, NO_KEY if none
+	char getKey(int8_t station);
+
+	Station_Stats &getStats(int8_t station);
+	// bus bytes per second since the station's stats were reset
+	uint32_t throughput(int8_t station);
+	void resetStats(int8_t station);
+
+private:
+	struct Station {
+		LCD_I2C *lcd;
+		Keypad_I2C *keypad;
+		uint8_t priority;
+		unsigned long scanDue;   // micros()
+		unsigned long since;     // micros() of the last stats reset
+		uint32_t bytes0;         // busBytes() at the last stats reset
+		char keys[I2C_SCHEDULER_KEYS];
+		uint8_t keyHead, keyTail;
+		Station_Stats stats;
+	};
+
+	uint8_t order(uint8_t *ids);
+	bool scan(Station &s, unsigned long now);
+	bool display(Station &s);
+	uint32_t busBytes(Station &s);
+	void account(Station &s, unsigned long start);
+
+	Station _stations[I2C_SCHEDULER_STATIONS];
+	uint8_t _count;
+	uint8_t _next;           // first station in turn order
+	unsigned long _scanUs;
+};
+
+#endif // I2C_Scheduler_h
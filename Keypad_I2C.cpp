@@ -38,23 +38,45 @@
 */
 
 #include "Keypad_I2C.h"
-
-#define GPIOA 0x12		//MCP23017 GPIO reg
-#define GPIOB 0x13		//MCP23017 GPIO reg
-#define IODIRA 0x00		//MCP23017 I/O direction register
-#define IODIRB 0x01		//MCP23017 I/O direction register
-#define IOCON 0x0a		//MCP23017 I/O configuration register
-#define GPPUA 0x0c		//MCP23017 pullup resistors control
+#include <stdlib.h>
+#include <string.h>
 
 word iodirec = 0x00FF;  //0xffff  //direction of each bit - reset state = all inputs.
 byte iocon = 0x10;      // reset state for bank, disable slew control
 
 /////// Extended Keypad library functions. ////////////////////////////
 
+// only bank A pins go into the masks, bank B belongs to the LCD
+void Keypad_I2C::_pins( byte *row, byte *col, byte numRows, byte numCols ) {
+	rowpins = row;
+	colpins = col;
+	numrows = numRows;
+	numcols = numCols;
+	rowmask = colmask = 0;
+	bulk = true;
+	for( byte r = 0; r < numRows; r++ ) {
+		if( row[r] < 8 ) rowmask |= 1<<row[r];
+		else bulk = false;
+	}
+	for( byte c = 0; c < numCols; c++ ) {
+		if( col[c] < 8 ) colmask |= 1<<col[c];
+		else bulk = false;
+	}
+	intpin = -2;
+	armed = false;
+	debouncems = 10;     // Keypad's default
+	polltime = 0;
+	replay = false;
+	keybits = 0;
+	memset( colread, 0xFF, sizeof( colread ) );
+	scanreq = NULL;
+	scanning = false;
+} // _pins( )
+
 
 // Let the user define a keymap - assume the same row/column count as defined in constructor
 void Keypad_I2C::begin(char *userKeymap) {
-	TwoWire::begin();
+	mcp->bus( ).begin( );
     Keypad::begin(userKeymap);
 	_begin( );
 	pinState = pinState_set( );
@@ -65,7 +87,7 @@ void Keypad_I2C::begin(char *userKeymap) {
 
 // Initialize MC17
 void Keypad_I2C::begin(void) {
-	TwoWire::begin();
+	mcp->bus( ).begin( );
 	_begin( );
 	pinState = pinState_set( );
 }
@@ -73,14 +95,16 @@ void Keypad_I2C::begin(void) {
 // Initialize MC17
 void Keypad_I2C::begin(byte address) {
 	i2caddr = address;
-	TwoWire::begin(address);
+	mcp = MCP23017::attach( address, mcp->bus( ) );
+	mcp->bus( ).begin( );
 	_begin( );
 	pinState = pinState_set( );
 }
 
 void Keypad_I2C::begin(int address) {
 	i2caddr = address;
-	TwoWire::begin(address);
+	mcp = MCP23017::attach( address, mcp->bus( ) );
+	mcp->bus( ).begin( );
 	_begin( );
 	pinState = pinState_set( );
 } // begin( int )
@@ -91,46 +115,39 @@ void Keypad_I2C::begin(int address) {
 
 void Keypad_I2C::_begin( void ) {
 	iodir_state = iodirec;
-	TwoWire::beginTransmission( (int)i2caddr );
-	TwoWire::write( IOCON ); // same as when reset
-	TwoWire::write( iocon );
-	TwoWire::endTransmission( );
-
-	TwoWire::beginTransmission( (int)i2caddr );
-	TwoWire::write( GPPUA ); // enable pullups on all inputs
-	TwoWire::write( 0xFF );
-	//TwoWire::write( 0xff );  // damages the bank b
-	TwoWire::endTransmission( );
-
-	TwoWire::beginTransmission( (int)i2caddr );
-	TwoWire::write( IODIRA ); // setup port direction - all inputs to start
-	TwoWire::write( lowByte( iodirec ) );
-	//TwoWire::write( highByte( iodirec ) ); // damages the bank b
-	TwoWire::endTransmission( );
-
-	TwoWire::beginTransmission( (int)i2caddr );
-	TwoWire::write( GPIOA );	//point register pointer to gpio reg
-	TwoWire::write( lowByte(iodirec) ); // make o/p latch agree with pulled-up pins
-	//TwoWire::write( highByte(iodirec) ); // damages the bank b
-	TwoWire::endTransmission( );
+	armed = false;
+	mcp->begin( );
+	// keep the byte mode bit, it is owned by LCD_I2C
+	mcp->updateRegister( IOCONA, ~IOCON_SEQOP, iocon ); // same as when reset
+	mcp->writeRegister( GPPUA, 0xFF ); // enable pullups on all inputs
+	// setup port direction - all inputs to start
+	mcp->writeRegister( IODIRA, lowByte( iodirec ) );
+	// make o/p latch agree with pulled-up pins
+	mcp->writeRegister( GPIOA, lowByte( iodirec ) );
 } // _begin( )
 
 // individual pin setup - modify pin bit in IODIR reg.
+// The expander skips the write when the direction does not change.
 void Keypad_I2C::pin_mode(byte pinNum, byte mode) {
+	if( replay ) {
+		if( !scanned ) _scan( );
+		return;
+	}
 	word mask = 0b0000000000000001 << pinNum;
 	if( mode == OUTPUT ) {
 		iodir_state &= ~mask;
 	} else {
 		iodir_state |= mask;
 	} // if mode
-	TwoWire::beginTransmission((int)i2caddr);
-	TwoWire::write( IODIRA );
-	TwoWire::write( lowByte( iodir_state ) );
-	//TwoWire::write( highByte( iodir_state ) ); // damages the bank b
-	TwoWire::endTransmission();
+	mcp->writeRegister( IODIRA, lowByte( iodir_state ) );
 } // pin_mode( )
 
 void Keypad_I2C::pin_write(byte pinNum, boolean level) {
+	if( replay ) {
+		if( !scanned ) _scan( );
+		if( level == LOW ) activecol = pinNum;
+		return;
+	}
 	word mask = 1<<pinNum;
 	if( level == HIGH ) {
 		pinState |= mask;
@@ -141,17 +158,15 @@ void Keypad_I2C::pin_write(byte pinNum, boolean level) {
 } // MC17xWrite( )
 
 
+// only the bank the pin is on is read
 int Keypad_I2C::pin_read(byte pinNum) {
-	TwoWire::beginTransmission((int)i2caddr);
-	TwoWire::write( GPIOA );
-	TwoWire::endTransmission( );
-	word mask = 0x1<<pinNum;
-	TwoWire::requestFrom((int)i2caddr, 2);
-	word pinVal = 0;
-	pinVal = TwoWire::read( );
-	pinVal |= ( TwoWire::read( )<<8 );
-	pinVal &= mask;
-	if( pinVal == mask ) {
+	if( replay ) {
+		if( !scanned ) _scan( );
+		return ( colread[activecol & 0x7] >> pinNum ) & 1;
+	}
+	byte pinVal = mcp->readRegister( pinNum < 8 ? GPIOA : GPIOB );
+	byte mask = 0x1<<( pinNum & 0x7 );
+	if( pinVal & mask ) {
 		return 1;
 	} else {
 		return 0;
@@ -160,22 +175,12 @@ int Keypad_I2C::pin_read(byte pinNum) {
 
 void Keypad_I2C::port_write( word i2cportval ) {
 // MCP23017 requires a register address on each write
-	TwoWire::beginTransmission((int)i2caddr);
-	TwoWire::write( GPIOA );
-	TwoWire::write( lowByte( i2cportval ) );
-	//TwoWire::write( highByte( i2cportval ) ); // damages the bank b
-	TwoWire::endTransmission();
+	mcp->writeRegister( GPIOA, lowByte( i2cportval ) );
 	pinState = i2cportval;
 } // port_write( )
 
 word Keypad_I2C::pinState_set( ) {
-	TwoWire::beginTransmission((int)i2caddr);
-	TwoWire::write( GPIOA );
-	TwoWire::endTransmission( );
-	TwoWire::requestFrom( (int)i2caddr, 2 );
-	pinState = 0;
-	pinState = TwoWire::read( );
-	pinState |= (TwoWire::read( )<<8);
+	pinState = mcp->readRegister16( GPIOA );
 	return pinState;
 } // set_pinState( )
 
@@ -186,11 +191,200 @@ word Keypad_I2C::iodir_read( ) {
 
 void Keypad_I2C::iodir_write( word iodir ) {
 	iodir_state = iodir;
-	TwoWire::beginTransmission((int)i2caddr);   // read current IODIR reg 
-	TwoWire::write( IODIRA );
-	TwoWire::write( lowByte( iodir_state ) );
-	//TwoWire::write( highByte( iodir_state ) ); // damages the bank b
-	TwoWire::endTransmission();
+	mcp->writeRegister( IODIRA, lowByte( iodir_state ) );
 } // iodir_write( )
 
+// transport counters and latencies of the expander
+I2C_Stats &Keypad_I2C::getStats( ) {
+	return mcp->getStats( );
+} // getStats( )
+
+
+/////// Idle mode. ////////////////////////////////////////////////////
+
+void Keypad_I2C::enableInterrupt( int intPin ) {
+	intpin = intPin;
+	if( intpin >= 0 ) pinMode( intpin, INPUT_PULLUP ); // INTA, active low
+	// rows idle high: DEFVAL compare flags a row for as long as it is low
+	mcp->updateRegister( DEFVALA, rowmask, 0xFF );
+	mcp->updateRegister( INTCONA, rowmask, 0xFF );
+} // enableInterrupt( )
+
+void Keypad_I2C::setDebounceTime( uint debounce ) {
+	Keypad::setDebounceTime( debounce );
+	debouncems = ( debounce < 1 ) ? 1 : debounce;
+} // setDebounceTime( )
+
+void Keypad_I2C::disableInterrupt( ) {
+	if( armed ) _disarm( );
+	intpin = -2;
+} // disableInterrupt( )
+
+// columns low, rows armed. Latch first, the pins are still inputs.
+void Keypad_I2C::_arm( ) {
+	port_write( pinState & ~colmask );
+	iodir_write( iodir_state & ~colmask );
+	mcp->updateRegister( GPINTENA, rowmask, 0xFF );
+	armed = true;
+} // _arm( )
+
+// columns back to high-Z, their latch stays low for scanMatrix()
+void Keypad_I2C::_disarm( ) {
+	mcp->updateRegister( GPINTENA, rowmask, 0 );
+	iodir_write( iodir_state | colmask );
+	armed = false;
+} // _disarm( )
+
+bool Keypad_I2C::_changed( ) {
+	if( intpin >= 0 ) return digitalRead( intpin ) == LOW;
+	// the flags stay up while a row is low, no faster than Keypad would scan
+	if( millis( ) - polltime < debouncems ) return false;
+	polltime = millis( );
+	return mcp->readRegister( INTFA ) & rowmask;
+} // _changed( )
+
+// nothing down and nothing left for the key list to report
+bool Keypad_I2C::_idle( ) {
+	for( byte i = 0; i < MAPSIZE; i++ ) {
+		if( bitMap[i] ) return false;
+	}
+	for( byte i = 0; i < LIST_MAX; i++ ) {
+		if( key[i].kstate != IDLE ) return false;
+	}
+	return true;
+} // _idle( )
+
+char Keypad_I2C::getKey( ) {
+	if( scanning ) mcp->bus( ).poll( );
+	if( armed ) {
+		if( !_changed( ) ) return NO_KEY;
+		_disarm( );
+	}
+	// Keypad only scans once its debounce time is up, the bulk scan runs
+	// on its first pin call
+	replay = bulk;
+	scanned = false;
+	char k = Keypad::getKey( );
+	replay = false;
+	if( ( intpin > -2 ) && _idle( ) ) _arm( );
+	return k;
+} // getKey( )
+
+bool Keypad_I2C::getKeys( ) {
+	if( scanning ) mcp->bus( ).poll( );
+	if( armed ) {
+		if( !_changed( ) ) return false;
+		_disarm( );
+	}
+	replay = bulk;
+	scanned = false;
+	bool activity = Keypad::getKeys( );
+	replay = false;
+	if( ( intpin > -2 ) && _idle( ) ) _arm( );
+	return activity;
+} // getKeys( )
+
+
+/////// Bulk scan. ////////////////////////////////////////////////////
+
+// The column latches stay low, a column is driven by making it an output.
+// Only one column is ever an output, pressing two keys in a row cannot
+// short a high and a low driver.
+word Keypad_I2C::scanMatrix( ) {
+	scanned = true;
+	if( armed ) _disarm( );
+	port_write( pinState & ~colmask );
+	byte idle = iodir_state | colmask;
+	keybits = 0;
+	for( byte c = 0; c < numcols; c++ ) {
+		byte pin = colpins[c] & 0x7;
+		iodir_write( idle & ~( 1<<pin ) );
+		colread[pin] = mcp->readRegister( GPIOA );
+	}
+	iodir_write( idle );
+	_keybits( );
+	return keybits;
+} // scanMatrix( )
+
+void Keypad_I2C::_keybits( ) {
+	keybits = 0;
+	for( byte c = 0; c < numcols; c++ ) {
+		byte pin = colpins[c] & 0x7;
+		for( byte r = 0; r < numrows; r++ ) {
+			if( !( colread[pin] & ( 1<<( rowpins[r] & 0x7 ) ) ) ) keybits |= 1<<( r * numcols + c );
+		}
+	}
+} // _keybits( )
+
+// first pin call of a replayed scan
+void Keypad_I2C::_scan( ) {
+	if( !scanreq ) {
+		scanMatrix( );
+		return;
+	}
+	scanned = true;
+	if( scanning && scanreq[2 * numcols].done( ) ) {
+		// the requests finish in order, the last one done means all are
+		byte *read = (byte *)( scanreq + 2 * numcols + 1 ) + numcols + 1;
+		bool ok = true;
+		for( byte i = 0; i <= 2 * numcols; i++ ) {
+			if( scanreq[i].status != I2C_OK ) ok = false;
+		}
+		if( ok ) {
+			for( byte c = 0; c < numcols; c++ ) colread[colpins[c] & 0x7] = read[c];
+			_keybits( );
+		}
+		scanning = false;
+	}
+	if( !scanning ) _submit( );
+} // _scan( )
+
 
+/////// Asynchronous scan. ////////////////////////////////////////////
+
+bool Keypad_I2C::enableAsync( ) {
+	if( scanreq ) return true;
+	if( !bulk ) return false;
+	// the requests, then IODIRA values and GPIOA reads
+	scanreq = (I2C_Request *)malloc( ( 2 * numcols + 1 ) * sizeof( I2C_Request ) + 2 * numcols + 1 );
+	if( !scanreq ) return false;
+	for( byte i = 0; i <= 2 * numcols; i++ ) scanreq[i].status = I2C_OK;
+	scanning = false;
+	return true;
+} // enableAsync( )
+
+void Keypad_I2C::disableAsync( ) {
+	if( !scanreq ) return;
+	if( scanning ) mcp->bus( ).flush( );
+	free( scanreq );
+	scanreq = NULL;
+	scanning = false;
+} // disableAsync( )
+
+// Same transactions as scanMatrix(). The latch and the idle direction are
+// set first with the expander's copy, the queued writes leave IODIRA as
+// the copy has it.
+void Keypad_I2C::_submit( ) {
+	if( armed ) _disarm( );
+	port_write( pinState & ~colmask );
+	byte idle = iodir_state | colmask;
+	iodir_write( idle );
+	byte *dir = (byte *)( scanreq + 2 * numcols + 1 );
+	byte *read = dir + numcols + 1;
+	byte addr = mcp->address( );
+	I2C_Bus &bus = mcp->bus( );
+	I2C_Stats *stats = &mcp->getStats( );
+	mcp->flush( ); // the queued requests bypass the expander's copy
+	for( byte c = 0; c < numcols; c++ ) {
+		dir[c] = idle & ~( 1<<( colpins[c] & 0x7 ) );
+		scanreq[2 * c].set( addr, IODIRA, &dir[c], 1, false, stats );
+		bus.submit( scanreq[2 * c] );
+		scanreq[2 * c + 1].set( addr, GPIOA, &read[c], 1, true, stats );
+		bus.submit( scanreq[2 * c + 1] );
+	}
+	dir[numcols] = idle;
+	scanreq[2 * numcols].set( addr, IODIRA, &dir[numcols], 1, false, stats );
+	bus.submit( scanreq[2 * numcols] );
+	scanning = true;
+	bus.poll( );
+} // _submit( )
@@ -40,21 +40,24 @@
 #define Keypad_I2C_H
 
 #include "Keypad.h"
-//#include "../Wire/Wire.h"
-#include "Wire.h"
+#include "MCP23017.h"
 
-class Keypad_I2C : public Keypad, public TwoWire {
+// The bus is a reference to an I2C_Bus, I2CBus (Wire) unless another one
+// is given, shared with anything else on that bus.
+class Keypad_I2C : public Keypad {
 public:
-	Keypad_I2C(char* userKeymap, byte* row, byte* col, byte numRows, byte numCols, byte address) :
-		Keypad(userKeymap, row, col, numRows, numCols) { i2caddr = address; }
+	Keypad_I2C(char* userKeymap, byte* row, byte* col, byte numRows, byte numCols, byte address, I2C_Bus &bus = I2CBus) :
+		Keypad(userKeymap, row, col, numRows, numCols) { i2caddr = address; mcp = MCP23017::attach( address, bus ); _pins( row, col, numRows, numCols ); }
+	// share an expander object, e.g. with LCD_I2C on the same chip
+	Keypad_I2C(char* userKeymap, byte* row, byte* col, byte numRows, byte numCols, MCP23017 &expander) :
+		Keypad(userKeymap, row, col, numRows, numCols) { i2caddr = expander.address( ); mcp = &expander; _pins( row, col, numRows, numCols ); }
 
 	// Keypad function
 	void begin(char *userKeymap);
-	// Wire function
+	// starts the bus and the expander
 	void begin(void);
-	// Wire function
+	// the same for an expander at another address on the same bus
 	void begin(byte address);
-	// Wire function
 	void begin(int address);
 
 	void pin_mode(byte pinNum, byte mode);
@@ -67,16 +70,74 @@ public:
 	// access functions for IODIR state copy
 	word iodir_read( );
 	void iodir_write( word iodir );
+	// bus transactions, NACKs, retries and latency of the expander
+	I2C_Stats &getStats( );
+
+	// Idle mode: while no key is down all columns are driven low and the
+	// row inputs are armed for interrupt-on-change, so getKey()/getKeys()
+	// stay off the bus until a row goes low. intPin is the Arduino pin wired
+	// to INTA, -1 polls INTFA with a single register read instead, at most
+	// once per debounce interval. Only the INTA pin keeps an idle keypad
+	// entirely off the bus.
+	void enableInterrupt( int intPin = -1 );
+	// Keypad's, also paces the INTFA polls
+	void setDebounceTime( uint debounce );
+	void disableInterrupt( );
+	char getKey( );
+	bool getKeys( );
+
+	// Bulk scan: each column is activated with one IODIRA write and all rows
+	// are read with one GPIOA read, two transactions per column. Returns the
+	// keys that are down, bit ( row * numCols + col ). getKey()/getKeys() use
+	// it and replay the result to Keypad's scan instead of going per pin.
+	word scanMatrix( );
+
+	// Asynchronous scan (bulk scan only): the scan transactions go through
+	// the I2C_Bus queue and getKey()/getKeys() move them along instead of
+	// waiting. Keypad's scan is answered with the last complete result, so a
+	// key shows up one debounce interval later. Allocates 2 * numCols + 1
+	// requests, returns false if there is no memory or no bulk scan.
+	bool enableAsync( );
+	void disableAsync( );
 
 private:
     // I2C device address
     byte i2caddr;
+	// expander, shared with anything else on the same chip
+	MCP23017 *mcp;
 	// I2C pin_write state persistant storage
 	word pinState;
 //	byte pin_iosetup( );
 	// MC17 setup
 	word iodir_state;    // copy of IODIR register
 	void _begin( void );
+	// keypad wiring, also as port bit masks
+	byte *rowpins, *colpins;
+	byte numrows, numcols;
+	byte rowmask, colmask;
+	// bulk scan
+	bool bulk;           // all pins on bank A
+	bool replay;         // pin_* calls are answered from colread
+	bool scanned;
+	byte activecol;      // column pin the replayed scan drives
+	byte colread[8];     // GPIOA read while the column on that pin was low
+	word keybits;
+	void _pins( byte *row, byte *col, byte numRows, byte numCols );
+	void _scan( );
+	void _keybits( );
+	// asynchronous scan
+	I2C_Request *scanreq;  // per column IODIRA write and GPIOA read, then IODIRA idle
+	bool scanning;         // scanreq queued
+	void _submit( );
+	// idle mode
+	int intpin;          // -2 disabled, -1 INTFA polled, else INTA pin
+	bool armed;
+	uint debouncems;     // copy of Keypad's debounce time
+	unsigned long polltime;  // millis() of the last INTFA poll
+	void _arm( );
+	void _disarm( );
+	bool _changed( );
+	bool _idle( );
 };
 
 
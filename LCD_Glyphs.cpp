@@ -0,0 +1,77 @@
+#include "LCD_Glyphs.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#endif
+
+LCD_Glyphs::LCD_Glyphs(LCD_I2C &lcd, const uint8_t (*table)[8], uint8_t count) : _lcd(lcd) {
+	_table = table;
+	_count = count;
+	begin();
+}
+
+void LCD_Glyphs::begin(uint8_t first, uint8_t slots) {
+	if (first >= LCD_GLYPH_SLOTS) first = LCD_GLYPH_SLOTS - 1;
+	if (slots > LCD_GLYPH_SLOTS - first) slots = LCD_GLYPH_SLOTS - first;
+	_first = first;
+	_slots = slots;
+	_uploads = 0;
+	invalidate();
+}
+
+void LCD_Glyphs::invalidate() {
+	_used = 0;
+}
+
+size_t LCD_Glyphs::print(uint8_t glyph) {
+	uint8_t c = code(glyph);
+	if (c == 0xFF) return 0;
+	return _lcd.write(c);
+}
+
+uint8_t LCD_Glyphs::code(uint8_t glyph) {
+	if ((glyph >= _count) || (_slots == 0)) return 0xFF;
+	int8_t pos = find(glyph);
+	if (pos < 0) {
+		// a free slot, or the one of the least recently used glyph
+		uint8_t slot;
+		if (_used < _slots) {
+			slot = _first + _used;
+			pos = _used++;
+		} else {
+			pos = _used - 1;
+			slot = _slot[pos];
+		}
+		uint8_t bitmap[8];
+		for (uint8_t i = 0; i < 8; i++) bitmap[i] = pgm_read_byte(&_table[glyph][i]);
+		_lcd.createChar(slot, bitmap);
+		_glyph[pos] = glyph;
+		_slot[pos] = slot;
+		_uploads++;
+	}
+	touch(pos);
+	return 8 + _slot[0];
+}
+
+bool LCD_Glyphs::resident(uint8_t glyph) const {
+	return find(glyph) >= 0;
+}
+
+int8_t LCD_Glyphs::find(uint8_t glyph) const {
+	for (uint8_t i = 0; i < _used; i++) {
+		if (_glyph[i] == glyph) return i;
+	}
+	return -1;
+}
+
+// moves the entry at pos to the front, the others keep their order
+void LCD_Glyphs::touch(uint8_t pos) {
+	uint8_t glyph = _glyph[pos];
+	uint8_t slot = _slot[pos];
+	for (; pos > 0; pos--) {
+		_glyph[pos] = _glyph[pos - 1];
+		_slot[pos] = _slot[pos - 1];
+	}
+	_glyph[0] = glyph;
+	_slot[0] = slot;
+}
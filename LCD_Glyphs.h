@@ -0,0 +1,70 @@
+#ifndef LCD_Glyphs_h
+#define LCD_Glyphs_h
+
+/*
+  LCD_Glyphs  custom characters beyond the 8 CGRAM slots of the HD44780
+
+  The sketch keeps any number of 5x8 glyphs in a PROGMEM table and prints
+  them by index. A glyph is uploaded to a CGRAM slot the first time it is
+  printed and stays there, so printing it again is a single data byte.
+  When every slot is taken the least recently printed glyph gives up its
+  slot. Cells still showing the evicted glyph change with it, so no more
+  glyphs than slots should be on screen at the same time.
+
+  Usage:
+    const uint8_t icons[][8] PROGMEM = { {...}, {...}, ... };
+    LCD_Glyphs glyphs(lcd, icons, sizeof(icons) / sizeof(icons[0]));
+    lcd.setCursor(0, 1);
+    glyphs.print(BAR_3);
+*/
+
+#include <inttypes.h>
+#if defined(ARDUINO) && (ARDUINO >= 100)
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include "LCD_I2C.h"
+
+#define LCD_GLYPH_SLOTS 8
+
+class LCD_Glyphs {
+public:
+	LCD_Glyphs(LCD_I2C &lcd, const uint8_t (*table)[8], uint8_t count);
+
+	// Hands slots first .. first + slots - 1 to the cache, leave the others
+	// to createChar(). Forgets what was resident.
+	void begin(uint8_t first = 0, uint8_t slots = LCD_GLYPH_SLOTS);
+	// after lcd.begin() or a createChar() into the cache's slots
+	void invalidate();
+
+	// Prints a glyph at the cursor, uploading it first if not resident.
+	// Returns 0 for an index outside the table.
+	size_t print(uint8_t glyph);
+	// The character code that shows a glyph, e.g. to put it in a string;
+	// uploads it if needed and counts as a use. 8-15, the HD44780 mirror of
+	// CGRAM codes 0-7, since a 0 would end the string. 0xFF outside the
+	// table.
+	uint8_t code(uint8_t glyph);
+	// true if printing the glyph costs a single data byte
+	bool resident(uint8_t glyph) const;
+
+	// CGRAM uploads since begin(), each one a command and 8 data bytes
+	uint16_t uploads() const { return _uploads; }
+
+private:
+	int8_t find(uint8_t glyph) const;
+	void touch(uint8_t pos);
+
+	LCD_I2C &_lcd;
+	const uint8_t (*_table)[8];
+	uint8_t _count;
+	uint8_t _first, _slots;
+	// resident glyphs, most recently used first, slot number alongside
+	uint8_t _glyph[LCD_GLYPH_SLOTS];
+	uint8_t _slot[LCD_GLYPH_SLOTS];
+	uint8_t _used;
+	uint16_t _uploads;
+};
+
+#endif // LCD_Glyphs_h
@@ -8,18 +8,16 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <inttypes.h>
-#if defined (__AVR_ATtiny84__) || defined(__AVR_ATtiny85__) || (__AVR_ATtiny2313__)
-#include "TinyWireM.h"
-#define Wire TinyWireM
-#else
-#include <Wire.h>
-#endif
 #if defined(ARDUINO) && (ARDUINO >= 100) //scl
 #include "Arduino.h"
 #else
 #include "WProgram.h"
 #endif
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#endif
 
 //  Pinout for LCD interfacing with MCP23017
 //  LCD ->  MCP23017
@@ -45,23 +43,17 @@
 #define M17_BIT_RS 0x8000  // pin 15
 #define M17_BIT_BL 0x100   // pin 8 
 
-static inline void wiresend(uint8_t x) {
-#if ARDUINO >= 100
-  Wire.write((uint8_t)x);
-#else
-  Wire.send(x);
-#endif
-}
-
-static inline uint8_t wirerecv(void) {
-#if ARDUINO >= 100
-  return Wire.read();
-#else
-  return Wire.receive();
-#endif
-}
-
+// queue entry flags, the value is in the low byte
+#define LCD_Q_DATA   0x01  // RS high
+#define LCD_Q_NIBBLE 0x02  // high nibble only, reset sequence
+#define LCD_Q_SLOW   0x04  // wait LCD_WAIT_SLOW_US afterwards
+#define LCD_Q_INIT   0x08  // wait LCD_WAIT_INIT_US afterwards
+#define LCD_QUEUE_MASK (LCD_QUEUE_SIZE - 1)
 
+// digits are counted by subtraction, the AVR has no divide instruction
+static const uint32_t powers_of_ten[] PROGMEM = {
+  1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL, 1000UL, 100UL, 10UL, 1UL
+};
 
 // When the display powers up, it is configured as follows:
 //
@@ -84,13 +76,39 @@ static inline uint8_t wirerecv(void) {
 // for when the sketch calls begin(), except configuring the expander, which
 // is required by any setup.
 
-LCD_I2C::LCD_I2C(uint8_t i2cAddr) {
+// i2cAddr is the chip address, 0x20-0x27, or just its A2 A1 A0 bits
+LCD_I2C::LCD_I2C(uint8_t i2cAddr, I2C_Bus &bus) {
+  init(MCP23017::attach((i2cAddr < 8) ? (MCP23017_BASE_ADDRESS | i2cAddr) : i2cAddr, bus));
+}
+
+LCD_I2C::LCD_I2C(MCP23017 &expander) {
+  init(&expander);
+}
+
+LCD_I2C::~LCD_I2C() {
+  // the bus queue still points into a transfer it has not finished
+  if (_xfer) {
+    while (!_xfer->req.done()) _mcp->bus().poll();
+  }
+  free(_queue);
+  free(_xfer);
+  if (_fbheap) free(_fb);
+}
+
+void LCD_I2C::init(MCP23017 *expander) {
   // Construction for LCD
   _backlightval = LCD_BACKLIGHT;
   _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS; // in case they forget to call begin() at least we have something
   dotsize = LCD_5x10DOTS;
 
-  _i2cAddr = i2cAddr;
+  _mcp = expander;
+  _fb = NULL;
+  _fbheap = false;
+  _numcols = 0;
+  _paneladdr = 0xFF;
+  _queue = NULL;
+  _xfer = NULL;
+  _qhead = _qtail = 0;
 }
 
 void LCD_I2C::begin(uint8_t cols, uint8_t rows){
@@ -98,20 +116,31 @@ void LCD_I2C::begin(uint8_t cols, uint8_t rows){
   // SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
   // according to datasheet, we need at least 40ms after power rises above 2.7V
   // before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
-  delay(50);
+  if (_queue) {
+    // asynchronous: drop anything pending, poll() waits for the panel
+    _qhead = _qtail = 0;
+    _qready = micros() + LCD_WAIT_POWER_US;
+  } else {
+    delay(50);
+  }
 
-  Wire.begin();
+  _mcp->bus().begin();
+  _mcp->begin();
 
-  Wire.beginTransmission(MCP23017_ADDRESS | _i2cAddr);
-  wiresend(IODIRB);
-  wiresend(0x00); 
-  Wire.endTransmission();
+  _mcp->writeRegister(IODIRB, 0x00);
+
+  // byte mode: with IOCON.BANK = 0 the register pointer now toggles between
+  // GPIOB and GPIOA instead of running into OLATA/OLATB, so a whole character
+  // can be streamed in one transaction (see burstBytes8b)
+  _mcp->updateRegister(IOCONA, IOCON_SEQOP, IOCON_SEQOP);
 
   if (rows > 1) {
     _displayfunction |= LCD_2LINE;
   }
   _numrows = rows;
+  _numcols = cols;
   _currline = 0;
+  disableFramebuffer(); // it is sized from cols/rows
 
   // for some 1 line displays you can select a 10 pixel high font
   if ((dotsize != 0) && (rows == 1)) {
@@ -127,19 +156,24 @@ void LCD_I2C::begin(uint8_t cols, uint8_t rows){
   //  of the HD44780 datasheet - (kch)
 
 
-  for (uint8_t i=0;i < 3;i++) {
-    burstBits8b((M17_BIT_EN|M17_BIT_D5|M17_BIT_D4) >> 8);
-    burstBits8b((M17_BIT_D5|M17_BIT_D4) >> 8);
+  if (_queue) {
+    for (uint8_t i=0;i < 3;i++) enqueue(0x30, LCD_Q_NIBBLE | LCD_Q_INIT);
+    enqueue(0x20, LCD_Q_NIBBLE);
+  } else {
+    // EN high and low in one stream, separate writes could be combined
+    uint8_t pulse[2] = { (M17_BIT_EN|M17_BIT_D5|M17_BIT_D4) >> 8, (M17_BIT_D5|M17_BIT_D4) >> 8 };
+    for (uint8_t i=0;i < 3;i++) burstBytes8b(pulse, 2);
+    pulse[0] = (M17_BIT_EN|M17_BIT_D5) >> 8;
+    pulse[1] = M17_BIT_D5 >> 8;
+    burstBytes8b(pulse, 2);
   }
-  burstBits8b((M17_BIT_EN|M17_BIT_D5) >> 8);
-  burstBits8b(M17_BIT_D5 >> 8);
 
-  delay(5); // this shouldn't be necessary, but sometimes 16MHz is stupid-fast.
+  settle(); // this shouldn't be necessary, but sometimes 16MHz is stupid-fast.
 
   command(LCD_FUNCTIONSET | _displayfunction); // then send 0010NF00 (N=rows, F=font)
-  delay(5); // for safe keeping...
+  settle(); // for safe keeping...
   command(LCD_FUNCTIONSET | _displayfunction); // ... twice.
-  delay(5); // done!
+  settle(); // done!
 
   // turn on the LCD with our defaults. since these libs seem to use personal preference, I like a cursor.
   _displaycontrol = (LCD_DISPLAYON|M17_BIT_BL);
@@ -155,21 +189,117 @@ void LCD_I2C::begin(uint8_t cols, uint8_t rows){
 /********** high level commands, for the user! */
 void LCD_I2C::clear()
 {
+  if (_fb) {
+    memset(_fb, ' ', _numcols * _numrows);
+    _fbcol = _fbrow = 0;
+    return;
+  }
   command(LCD_CLEARDISPLAY);  // clear display, set cursor position to zero
-  delayMicroseconds(2000);  // this command takes a long time!
+  _paneladdr = 0;
+  if (!_queue) delayMicroseconds(2000);  // this command takes a long time!
 }
 
 void LCD_I2C::home()
 {
+  if (_fb) {
+    _fbcol = _fbrow = 0;
+    return;
+  }
   command(LCD_RETURNHOME);  // set cursor position to zero
-  delayMicroseconds(2000);  // this command takes a long time!
+  _paneladdr = 0;
+  if (!_queue) delayMicroseconds(2000);  // this command takes a long time!
 }
 
 void LCD_I2C::setCursor(uint8_t col, uint8_t row)
 {
-  int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-  if ( row > _numrows ) row = _numrows - 1;    // we count rows starting from 0
-  command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+  if (row >= _numrows) row = _numrows - 1;    // we count rows starting from 0
+  moveCursor(col, row, rowAddress(row) + col);
+}
+
+// addr is the DDRAM address of col, row
+void LCD_I2C::moveCursor(uint8_t col, uint8_t row, uint8_t addr)
+{
+  if (_fb) {
+    _fbcol = col;
+    _fbrow = row;
+    return;
+  }
+  _paneladdr = addr;
+  command(LCD_SETDDRAMADDR | addr);
+}
+
+/********** framebuffer */
+bool LCD_I2C::enableFramebuffer()
+{
+  if (_fb) return true;
+  if (_numcols == 0) return false; // begin() not called yet
+  uint8_t *fb = (uint8_t *)malloc(2 * _numcols * _numrows);
+  if (!fb) return false;
+  enableFramebuffer(fb);
+  _fbheap = true;
+  return true;
+}
+
+// fb holds 2 * cols * rows bytes
+bool LCD_I2C::enableFramebuffer(uint8_t *fb)
+{
+  if (_fb) return true;
+  if (_numcols == 0) return false;
+  // start from a known panel: both copies blank
+  clear();
+  _fb = fb;
+  _fbheap = false;
+  memset(_fb, ' ', 2 * _numcols * _numrows);
+  _fbcol = _fbrow = 0;
+  _paneladdr = 0;
+  return true;
+}
+
+void LCD_I2C::disableFramebuffer()
+{
+  if (_fbheap) free(_fb);
+  _fb = NULL;
+  _fbheap = false;
+}
+
+// Sends the runs of changed cells. A run is extended over a single unchanged
+// cell, rewriting it costs the same as the LCD_SETDDRAMADDR command that
+// would otherwise be needed to skip it. The command is left out entirely
+// when the run starts where the panel's address counter already is.
+bool LCD_I2C::flush()
+{
+  if (!_fb) return false;
+  uint8_t *panel = _fb + _numcols * _numrows;
+  for (uint8_t row = 0; row < _numrows; row++) {
+    uint8_t *want = _fb + row * _numcols;
+    uint8_t *have = panel + row * _numcols;
+    uint8_t col = 0;
+    while (col < _numcols) {
+      if (want[col] == have[col]) {
+        col++;
+        continue;
+      }
+      uint8_t end = col + 1;
+      while (end < _numcols) {
+        if (want[end] != have[end]) end++;
+        else if ((end + 1 < _numcols) && (want[end + 1] != have[end + 1])) end += 2;
+        else break;
+      }
+      if (_queue) {
+        // leave the rest for the next call rather than wait for room,
+        // one entry is kept for the address command
+        uint8_t room = queueRoom();
+        if (room < 2) return true;
+        if (end - col > room - 1) end = col + room - 1;
+      }
+      uint8_t addr = rowAddress(row) + col;
+      burstData(want + col, end - col, (addr != _paneladdr) ? (LCD_SETDDRAMADDR | addr) : 0);
+      memcpy(have + col, want + col, end - col);
+      _paneladdr = addr + (end - col);
+      col = end;
+    }
+  }
+  return false;
 }
 
 // Turn the display on/off (quickly)
@@ -240,7 +370,169 @@ void LCD_I2C::noAutoscroll(void) {
 void LCD_I2C::createChar(uint8_t location, uint8_t charmap[]) {
   location &= 0x7; // we only have 8 locations 0-7
   command(LCD_SETCGRAMADDR | (location << 3));
-  for (int i=0; i<8; i++) { write(charmap[i]); }
+  burstData(charmap, 8);
+  // The address counter now points into CGRAM. Put it back where printing
+  // left off when that is known, a framebuffer flush sets it anyway.
+  if (_fb || (_paneladdr == 0xFF)) _paneladdr = 0xFF;
+  else command(LCD_SETDDRAMADDR | _paneladdr);
+}
+
+/********** fields */
+void LCD_I2C::printField(uint8_t col, uint8_t row, uint8_t width, long value, uint8_t decimals, uint8_t align)
+{
+  unsigned long v = value;
+  printNumber(col, row, width, (value < 0) ? 0 - v : v, value < 0, decimals, align);
+}
+
+void LCD_I2C::printField(uint8_t col, uint8_t row, uint8_t width, unsigned long value, uint8_t decimals, uint8_t align)
+{
+  printNumber(col, row, width, value, false, decimals, align);
+}
+
+void LCD_I2C::printNumber(uint8_t col, uint8_t row, uint8_t width, unsigned long v, bool negative, uint8_t decimals, uint8_t align)
+{
+  char text[12]; // sign, 10 digits and the point
+  char *p = text;
+  if (negative) *p++ = '-';
+  if (decimals > 9) decimals = 9;
+  // no leading zeros, except the one in front of the point
+  uint8_t i = 0;
+  while ((i < 9 - decimals) && (v < pgm_read_dword(&powers_of_ten[i]))) i++;
+  for (; i < 10; i++) {
+    if (i == 10 - decimals) *p++ = '.';
+    uint32_t power = pgm_read_dword(&powers_of_ten[i]);
+    char digit = '0';
+    while (v >= power) {
+      v -= power;
+      digit++;
+    }
+    *p++ = digit;
+  }
+  sendField(col, row, width, text, p - text, align, true);
+}
+
+void LCD_I2C::printField(uint8_t col, uint8_t row, uint8_t width, const char *text, uint8_t align)
+{
+  size_t len = strlen(text);
+  sendField(col, row, width, text, (len > LCD_FIELD_MAX) ? LCD_FIELD_MAX : len, align, false);
+}
+
+// a number too long for the field shows as '#', text is cut
+void LCD_I2C::sendField(uint8_t col, uint8_t row, uint8_t width, const char *text, uint8_t len, uint8_t align, bool number)
+{
+  if ((row >= _numrows) || (col >= _numcols)) return;
+  if (width > _numcols - col) width = _numcols - col;
+  if (width > LCD_FIELD_MAX) width = LCD_FIELD_MAX;
+  uint8_t field[LCD_FIELD_MAX];
+  if (len > width) {
+    if (number) text = NULL;
+    len = width;
+  }
+  memset(field, text ? ' ' : '#', width);
+  if (text) memcpy(field + ((align == LCD_ALIGN_RIGHT) ? width - len : 0), text, len);
+
+  if (_fb) {
+    _fbcol = col;
+    _fbrow = row;
+    write(field, width);
+    return;
+  }
+  uint8_t addr = rowAddress(row) + col;
+  burstData(field, width, LCD_SETDDRAMADDR | addr);
+  _paneladdr = (_displaymode == LCD_ENTRYLEFT) ? addr + width : 0xFF;
+}
+
+/********** asynchronous mode */
+bool LCD_I2C::enableAsync()
+{
+  if (_queue) return true;
+  _queue = (uint16_t *)malloc(LCD_QUEUE_SIZE * sizeof(uint16_t));
+  _xfer = (Transfer *)malloc(sizeof(Transfer));
+  if (!_queue || !_xfer) {
+    free(_queue);
+    free(_xfer);
+    _queue = NULL;
+    _xfer = NULL;
+    return false;
+  }
+  _xfer->req.status = I2C_OK;
+  _xfer->wait = 0;
+  _qhead = _qtail = 0;
+  _qready = micros();
+  return true;
+}
+
+void LCD_I2C::disableAsync()
+{
+  while (poll());
+  free(_queue);
+  free(_xfer);
+  _queue = NULL;
+  _xfer = NULL;
+}
+
+// Consecutive entries that only need LCD_WAIT_US go out together, the bus
+// time between two of them already covers the wait. An entry with a longer
+// wait ends the transaction and sets the deadline for the next one, which
+// counts from the moment the transaction is off the bus.
+bool LCD_I2C::poll()
+{
+  if (!_queue) return false;
+  if (_xfer->wait) {
+    _mcp->bus().poll();
+    if (!_xfer->req.done()) return true;
+    _qready = micros() + _xfer->wait;
+    _xfer->wait = 0;
+  }
+  if (_qhead == _qtail) return false;
+  if ((long)(micros() - _qready) < 0) return true;
+
+  uint8_t buf[LCD_BURST_CHARS * 4];
+  uint8_t len = 0;
+  unsigned long wait = LCD_WAIT_US;
+  do {
+    uint16_t entry = _queue[_qtail];
+    uint8_t flags = entry >> 8;
+    _qtail = (_qtail + 1) & LCD_QUEUE_MASK;
+    packNibbles(entry & 0xFF, flags & LCD_Q_DATA, buf + len);
+    len += (flags & LCD_Q_NIBBLE) ? 2 : 4;
+    if (flags & LCD_Q_INIT) wait = LCD_WAIT_INIT_US;
+    else if (flags & LCD_Q_SLOW) wait = LCD_WAIT_SLOW_US;
+  } while ((wait == LCD_WAIT_US) && (_qhead != _qtail) && (len <= sizeof(buf) - 4));
+  if ((len <= MCP23017_STREAM_MAX) && _mcp->streamAsync(GPIOB, buf, len, _xfer->req, _xfer->out)) {
+    _xfer->wait = wait;
+    // start it, and on cores without a TWI engine send it right away
+    _mcp->bus().poll();
+    if (!_xfer->req.done()) return true;
+    _xfer->wait = 0;
+  } else {
+    burstBytes8b(buf, len);
+  }
+  _qready = micros() + wait;
+  return _qhead != _qtail;
+}
+
+uint8_t LCD_I2C::queueRoom()
+{
+  if (!_queue) return 0;
+  return (_qtail - _qhead - 1) & LCD_QUEUE_MASK;
+}
+
+void LCD_I2C::enqueue(uint8_t value, uint8_t flags)
+{
+  // clear and home are the only slow commands
+  if (!(flags & LCD_Q_DATA) && (value != 0) && (value < LCD_ENTRYMODESET)) flags |= LCD_Q_SLOW;
+  // full: wait for room rather than losing a character
+  while (((_qhead + 1) & LCD_QUEUE_MASK) == _qtail) poll();
+  _queue[_qhead] = ((uint16_t)flags << 8) | value;
+  _qhead = (_qhead + 1) & LCD_QUEUE_MASK;
+}
+
+// settling time during begin(), queued as a wait after the last entry when asynchronous
+void LCD_I2C::settle()
+{
+  if (!_queue) delay(5);
+  else if (_qhead != _qtail) _queue[(_qhead - 1) & LCD_QUEUE_MASK] |= (uint16_t)LCD_Q_INIT << 8;
 }
 
 /*********** mid level commands, for sending data/cmds */
@@ -250,98 +542,143 @@ inline void LCD_I2C::command(uint8_t value) {
 
 #if defined(ARDUINO) && (ARDUINO >= 100) //scl
 inline size_t LCD_I2C::write(uint8_t value) {
-  send(value, HIGH);
+  write(&value, 1);
   return 1;
 }
 #else
 inline void LCD_I2C::write(uint8_t value) {
-  send(value, HIGH);
+  write(&value, 1);
 }
 #endif
 
+// Strings are packed LCD_BURST_CHARS characters per transaction. Between two
+// characters the bus carries at least four more bytes, which covers the 37us
+// the HD44780 needs per character up to 400kHz.
+#if defined(ARDUINO) && (ARDUINO >= 100)
+size_t LCD_I2C::write(const uint8_t *buffer, size_t size) {
+#else
+void LCD_I2C::write(const uint8_t *buffer, size_t size) {
+#endif
+  if (_fb) {
+    // characters past the end of the row are dropped
+    uint8_t *cell = _fb + _fbrow * _numcols;
+    for (size_t n = 0; n < size; n++, _fbcol++) {
+      if (_fbcol < _numcols) cell[_fbcol] = buffer[n];
+    }
+  } else {
+    burstData(buffer, size);
+    // followed left to right within a line, anything else is lost track of
+    uint8_t addr = _paneladdr + size;
+    if ((_paneladdr == 0xFF) || (_displaymode != LCD_ENTRYLEFT) || (size >= 40) || ((addr & 0x3F) >= 40)) addr = 0xFF;
+    _paneladdr = addr;
+  }
+#if defined(ARDUINO) && (ARDUINO >= 100)
+  return size;
+#endif
+}
+
+// A command, if not 0, goes out ahead of the data in the same burst. It
+// takes the same 37us as a character, e.g. LCD_SETDDRAMADDR.
+void LCD_I2C::burstData(const uint8_t *buffer, size_t size, uint8_t lead) {
+  if (_queue) {
+    if (lead) enqueue(lead, 0);
+    while (size--) enqueue(*buffer++, LCD_Q_DATA);
+    return;
+  }
+  uint8_t buf[LCD_BURST_CHARS * 4];
+  size_t n = 0;
+  while ((n < size) || lead) {
+    uint8_t len = 0;
+    if (lead) {
+      packNibbles(lead, LOW, buf);
+      len = 4;
+      lead = 0;
+    }
+    while ((n < size) && (len < sizeof(buf))) {
+      packNibbles(buffer[n++], HIGH, buf + len);
+      len += 4;
+    }
+    burstBytes8b(buf, len);
+  }
+}
+
 
 // Allows to set the backlight, if the LCD backpack is used
 void LCD_I2C::setBacklight(uint8_t status) {
   if (status == HIGH) _backlightval = M17_BIT_BL;
   else _backlightval = LCD_NOBACKLIGHT;
-  // we can't use burstBits16 it will damage bank A as well
-  burstBits8b(_backlightval >> 8);  // this is neccessary because of modifying only bank B
+  // only bank B, with write combining it goes out with the next bank A update
+  burstBits8b(_backlightval >> 8);
 }
 
 // write either command or data, burst it to the expander over I2C.
 void LCD_I2C::send(uint8_t value, uint8_t mode) {
+    if (_queue) {
+      enqueue(value, mode ? LCD_Q_DATA : 0);
+      return;
+    }
+    uint8_t buf[4];
+    packNibbles(value, mode, buf);
+    // all four strobes go out in a single transaction
+    burstBytes8b(buf, 4);
+}
+
+// turn a command or data byte into the four GPIOB values that strobe it in
+void LCD_I2C::packNibbles(uint8_t value, uint8_t mode, uint8_t *buf) {
    
     // n.b. RW bit stays LOW to write
-    uint8_t buf = _backlightval >> 8;
+    buf[0] = _backlightval >> 8;
     // send high 4 bits
-    if (value & 0x10) buf |= M17_BIT_D4 >> 8;
-    if (value & 0x20) buf |= M17_BIT_D5 >> 8;
-    if (value & 0x40) buf |= M17_BIT_D6 >> 8;
-    if (value & 0x80) buf |= M17_BIT_D7 >> 8;
+    if (value & 0x10) buf[0] |= M17_BIT_D4 >> 8;
+    if (value & 0x20) buf[0] |= M17_BIT_D5 >> 8;
+    if (value & 0x40) buf[0] |= M17_BIT_D6 >> 8;
+    if (value & 0x80) buf[0] |= M17_BIT_D7 >> 8;
     
     // if mode is HIGH data is sent otherwise commmand is sent
-    if (mode) buf |= (M17_BIT_RS|M17_BIT_EN) >> 8; // RS+EN
-    else buf |= M17_BIT_EN >> 8; // EN
-
-    burstBits8b(buf);
+    if (mode) buf[0] |= (M17_BIT_RS|M17_BIT_EN) >> 8; // RS+EN
+    else buf[0] |= M17_BIT_EN >> 8; // EN
 
     // resend w/ EN turned off
-    buf &= ~(M17_BIT_EN >> 8);
-    burstBits8b(buf);
+    buf[1] = buf[0] & ~(M17_BIT_EN >> 8);
     
     // send low 4 bits
-    buf = _backlightval >> 8;
-    // send high 4 bits
-    if (value & 0x01) buf |= M17_BIT_D4 >> 8;
-    if (value & 0x02) buf |= M17_BIT_D5 >> 8;
-    if (value & 0x04) buf |= M17_BIT_D6 >> 8;
-    if (value & 0x08) buf |= M17_BIT_D7 >> 8;
+    buf[2] = _backlightval >> 8;
+    if (value & 0x01) buf[2] |= M17_BIT_D4 >> 8;
+    if (value & 0x02) buf[2] |= M17_BIT_D5 >> 8;
+    if (value & 0x04) buf[2] |= M17_BIT_D6 >> 8;
+    if (value & 0x08) buf[2] |= M17_BIT_D7 >> 8;
     
-    if (mode) buf |= (M17_BIT_RS|M17_BIT_EN) >> 8; // RS+EN
-    else buf |= M17_BIT_EN >> 8; // EN
-    
-    burstBits8b(buf);
+    if (mode) buf[2] |= (M17_BIT_RS|M17_BIT_EN) >> 8; // RS+EN
+    else buf[2] |= M17_BIT_EN >> 8; // EN
     
     // resend w/ EN turned off
-    buf &= ~(M17_BIT_EN >> 8);
-    burstBits8b(buf);
+    buf[3] = buf[2] & ~(M17_BIT_EN >> 8);
 }
 
 
-// value byte order is BA
-void LCD_I2C::burstBits16(uint16_t value) {
+void LCD_I2C::burstBits8b(uint8_t value) {
   // we use this to burst bits to the GPIO chip whenever we need to. avoids repetitive code.
-  Wire.beginTransmission(MCP23017_ADDRESS | _i2cAddr);
-  wiresend(GPIOA);
-  wiresend(value & 0xFF); // send A bits
-  wiresend(value >> 8);   // send B bits
-  while(Wire.endTransmission());
+  _mcp->writeRegister(GPIOB, value);
 }
 
-void LCD_I2C::burstBits8b(uint8_t value) {
-  // we use this to burst bits to the GPIO chip whenever we need to. avoids repetitive code.
-  Wire.beginTransmission(MCP23017_ADDRESS | _i2cAddr);
-  wiresend(GPIOB);
-  wiresend(value); // last bits are crunched, we're done.
-  while(Wire.endTransmission());
+// stream several GPIOB values in one transaction, the expander keeps the
+// bank A latch as it is in between
+void LCD_I2C::burstBytes8b(const uint8_t *buf, uint8_t len) {
+  _mcp->stream(GPIOB, buf, len);
 }
 
 //direct access to the registers for interrupt setting and reading, also the tone function using buzzer pin
 uint8_t LCD_I2C::readRegister(uint8_t reg) {
-  // read a register
-  Wire.beginTransmission(MCP23017_ADDRESS | _i2cAddr);
-  wiresend(reg);  
-  Wire.endTransmission();
-  
-  Wire.requestFrom(MCP23017_ADDRESS | _i2cAddr, 1);
-  return wirerecv();
+  return _mcp->readRegister(reg);
 }
 
 
 //set registers
 void LCD_I2C::setRegister(uint8_t reg, uint8_t value) {
-    Wire.beginTransmission(MCP23017_ADDRESS | _i2cAddr);
-    wiresend(reg);
-    wiresend(value);
-    Wire.endTransmission();
+  _mcp->writeRegister(reg, value);
+}
+
+// transport counters and latencies of the expander
+I2C_Stats &LCD_I2C::getStats() {
+  return _mcp->getStats();
 }
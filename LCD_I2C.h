@@ -4,80 +4,24 @@
 #include <inttypes.h>
 #include "Print.h"
 #include "Wire.h"
+#include "MCP23017.h"
 
-#define MCP23017_ADDRESS 0x27  // default i2c address
-
-// Registers
-
-// I/O expander configuration register
-// bit7<R/W-0> BANK: Controls how the registers are addressed
-//     1 = The registers associated with each port are separated into different
-//         banks
-//     0 = The registers are in the same bank (addresses are sequential)
-// bit6<R/W-0> MIRROR: INT Pins Mirror bit
-//     1 = The INT pins are internally connected
-//     0 = The INT pins are not connected. INTA is associated with  PORTA and
-//         INTB is associated with PORTB
-// bit5<R/W-0> SEQOP: Sequential Operation mode bit
-//     1 = Sequential operation disabled, address pointer does not  increment
-//     0 = Sequential operation enabled, address pointer increments
-// bit4<R/W-0> DISSLW: Slew Rate control bit for SDA output
-//     1 = Slew rate disabled
-//     0 = Slew rate enabled
-// bit3<R/W-0> HAEN: Hardware Address Enable bit (MCP23S17 only) (Note 1)
-//     1 = Enables the MCP23S17 address pins.
-//     0 = Disables the MCP23S17 address pins.
-// bit2<R/W-0> ODR: Configures the INT pin as an open-drain output
-//     1 = Open-drain output (overrides the INTPOL bit.)
-//     0 = Active driver output (INTPOL bit sets the polarity.)
-// bit1<R/W-0> INTPOL: This bit sets the polarity of the INT output pin
-//     1 = Active-high
-//     0 = Active-low
-// bit0<U-0> Unimplemented: Read as '0'
-#define IOCONA 0x0A
-#define IOCONB 0x0B
-
-// PIN registers for direction IO<7:0> <R/W-1> (default: 0b11111111)
-#define IODIRA 0x00  //   1 = Pin is configured as an input
-#define IODIRB 0x01  //   0 = Pin is configured as an output
-
-// Input polarity registers  IP<7:0> <R/W-0> (default: 0b00000000)
-#define IPOLA 0x02 //   1 = GPIO register bit reflects the opposite logic state of the input pin
-#define IPOLB 0x03 //   0 = GPIO register bit reflects the same logic state of the input pin
-
- // Interrupt-on-change control registers   GPINT<7:0> <R/W-0> (default: 0b00000000)
-#define GPINTENA 0x04  //   1 = Enables GPIO input pin for interrupt-on-change event
-#define GPINTENB 0x05  //   0 = Disables GPIO input pin for interrupt-on-change event
-    
-// Default compare registers for interrupt-on-change
-#define DEFVALA 0x06  // DEF<7:0> <R/W-0> (default: 0b00000000)
-#define DEFVALB 0x07    
-
-// Interrupt control register IOC<7:0> <R/W-0> (default: 0b00000000)   
-#define INTCONA 0x08  //   1 = Pin value is compared against the associated bit in the DEFVAL register.
-#define INTCONB 0x09  //   0 = Pin value is compared against the previous pin value.
-
-// Pull-up resistor configuration registers PU<7:0> <R/W-0> (default: 0b00000000)
-#define GPPUA 0x0C  //   1 = Pull-up enabled
-#define GPPUB 0x0D  //   0 = Pull-up disabled
-
-// Interrupt flag registers  INT<7:0> <R-0> (default: 0b00000000)
-#define INTFA 0x0E //   1 = Pin caused interrupt.
-#define INTFB 0x0F //   0 = Interrupt not pending
-
-// Interrupt captured registers  ICP<7:0> <R-x>
-#define INTCAPA 0x10  //   1 = Logic-high
-#define INTCAPB 0x11  //   0 = Logic-low
-
-// Port registers  GP<7:0> <R/W-0> (default: 0b00000000)
-#define GPIOA 0x12  //   1 = Logic-high
-#define GPIOB 0x13  //   0 = Logic-low
-
-// Output latch registers  OL<7:0> <R/W-0> (default: 0b00000000)  
-#define OLATA 0x14  //   1 = Logic-high
-#define OLATB 0x15  //   0 = Logic-low
+// size of the Wire transmit buffer, register byte included
+#define LCD_WIRE_BUFFER I2C_WIRE_BUFFER
 
+// asynchronous mode: queued commands/data (power of two) and the time the
+// HD44780 needs after each class of entry, in microseconds
+#ifndef LCD_QUEUE_SIZE
+#define LCD_QUEUE_SIZE 32
+#endif
+#define LCD_WAIT_US      37    // most commands and data
+#define LCD_WAIT_SLOW_US 1520  // clear, home
+#define LCD_WAIT_INIT_US 5000  // reset sequence during begin()
+#define LCD_WAIT_POWER_US 50000UL // power up before begin() talks to the panel
 
+// characters per transaction for write(buffer, size): each one takes four
+// GPIOB strobes plus the bank A latch between them (8 bytes, 7 for the last)
+#define LCD_BURST_CHARS (LCD_WIRE_BUFFER / 8)
 
 // commands
 #define LCD_CLEARDISPLAY   0x01
@@ -120,9 +64,19 @@
 #define LCD_5x10DOTS 0x04
 #define LCD_5x8DOTS 0x00
 
+// printField() alignment and widest field
+#define LCD_ALIGN_LEFT  0
+#define LCD_ALIGN_RIGHT 1
+#ifndef LCD_FIELD_MAX
+#define LCD_FIELD_MAX 20
+#endif
+
 class LCD_I2C : public Print{
 public:
-	LCD_I2C(uint8_t i2cAddr);
+	LCD_I2C(uint8_t i2cAddr, I2C_Bus &bus = I2CBus);
+	LCD_I2C(MCP23017 &expander);
+	// frees the framebuffer and the queue, pending entries are dropped
+	~LCD_I2C();
 	void begin(uint8_t cols, uint8_t rows);
 	void clear();
 	void home();
@@ -139,31 +93,144 @@ public:
 	void autoscroll();
 	void noAutoscroll();
 	void setBacklight(uint8_t status); 
+	// Uploads a glyph to one of the 8 CGRAM slots. The cursor stays where
+	// printing left off unless it was moved with command() or ran off a line.
 	void createChar(uint8_t, uint8_t[]);
 	void setCursor(uint8_t, uint8_t); 
 
+	// Framebuffer mode: printing, setCursor(), clear() and home() only touch a
+	// RAM copy of the screen, flush() sends the cells that differ from the
+	// panel. Needs begin() first, allocates 2 * cols * rows bytes and clears
+	// the display. Returns false if there is not enough memory.
+	// In asynchronous mode flush() only queues what fits and returns true
+	// while changed cells are left for the next call.
+	bool enableFramebuffer();
+	void disableFramebuffer();
+	bool flush();
+
+	// Asynchronous mode: commands and data are queued and poll() sends them
+	// once the HD44780 is ready, so nothing blocks, not even begin(). Call it
+	// before begin() to make the initialisation non-blocking as well. When
+	// the queue is full the caller waits for room. poll() does at most one
+	// transaction and returns true while entries are pending. The
+	// transaction goes through the I2C_Bus queue, poll() only starts it and
+	// moves it along on later calls.
+	bool enableAsync();
+	void disableAsync();
+	bool poll();
+	// queue entries that can be added without waiting
+	uint8_t queueRoom();
+
+	// Fixed-width fields: the value is formatted, padded with blanks to
+	// width and sent with its cursor address as one burst, so a shorter
+	// value leaves no stale characters behind. value is fixed point with
+	// decimals digits after the point, printField(7, 1, 6, 2345, 2) shows
+	// " 23.45". A value that does not fit fills the field with '#'. The
+	// field is cut at the end of the row. There is an overload per integer
+	// type, so no call with an unsigned or 16-bit value is ambiguous.
+	void printField(uint8_t col, uint8_t row, uint8_t width, long value, uint8_t decimals = 0, uint8_t align = LCD_ALIGN_RIGHT);
+	void printField(uint8_t col, uint8_t row, uint8_t width, unsigned long value, uint8_t decimals = 0, uint8_t align = LCD_ALIGN_RIGHT);
+	void printField(uint8_t col, uint8_t row, uint8_t width, int value, uint8_t decimals = 0, uint8_t align = LCD_ALIGN_RIGHT) {
+		printField(col, row, width, (long)value, decimals, align); // a literal 0 is no string
+	}
+	void printField(uint8_t col, uint8_t row, uint8_t width, unsigned int value, uint8_t decimals = 0, uint8_t align = LCD_ALIGN_RIGHT) {
+		printField(col, row, width, (unsigned long)value, decimals, align);
+	}
+	void printField(uint8_t col, uint8_t row, uint8_t width, const char *text, uint8_t align = LCD_ALIGN_LEFT);
+
 	#if defined(ARDUINO) && (ARDUINO >= 100) // scl
 		virtual size_t write(uint8_t);
+		virtual size_t write(const uint8_t *, size_t);
 	#else
 		virtual void write(uint8_t);
+		virtual void write(const uint8_t *, size_t);
 	#endif
+	using Print::write;
 	void command(uint8_t);
     uint8_t readRegister(uint8_t);
     void setRegister(uint8_t, uint8_t);
-	
+	// bus transactions, NACKs, retries and latency of the expander
+	I2C_Stats &getStats();
+
+protected:
+	void moveCursor(uint8_t col, uint8_t row, uint8_t addr);
+	bool enableFramebuffer(uint8_t *fb);
+
 private:
+	// DDRAM address of the first column of a row: rows 2 and 3 continue
+	// rows 0 and 1 after the last column
+	uint8_t rowAddress(uint8_t row) { return ((row & 1) ? 0x40 : 0) + ((row & 2) ? _numcols : 0); }
 	// LCD functions and variables
+	void init(MCP23017 *);
 	void send(uint8_t, uint8_t);
-	void burstBits16(uint16_t);
+	void packNibbles(uint8_t, uint8_t, uint8_t *);
+	void burstData(const uint8_t *, size_t, uint8_t = 0);
+	void printNumber(uint8_t, uint8_t, uint8_t, unsigned long, bool, uint8_t, uint8_t);
+	void sendField(uint8_t, uint8_t, uint8_t, const char *, uint8_t, uint8_t, bool);
+	void enqueue(uint8_t, uint8_t);
+	void settle();
 	void burstBits8b(uint8_t);
+	void burstBytes8b(const uint8_t *, uint8_t);
 	uint8_t _displayfunction;
 	uint8_t _displaycontrol;
 	uint8_t _displaymode;
 	uint8_t _numrows,_currline;
-	uint8_t _i2cAddr;
+	uint8_t _numcols;
+	// framebuffer mode
+	uint8_t *_fb;        // cols * rows wanted cells followed by what the panel shows
+	bool _fbheap;        // _fb came from malloc()
+	uint8_t _fbcol, _fbrow;
+	uint8_t _paneladdr;  // DDRAM address counter of the panel, 0xFF if unknown
+	// asynchronous mode
+	uint16_t *_queue;    // flags << 8 | value
+	uint8_t _qhead, _qtail;
+	unsigned long _qready; // micros() when the panel takes the next entry
+	struct Transfer {
+		I2C_Request req;
+		unsigned long wait;  // us the panel needs once req is done, 0 if accounted for
+		uint8_t out[2 * MCP23017_STREAM_MAX - 1];
+	};
+	Transfer *_xfer;     // the transaction on the bus
+	MCP23017 *_mcp;
 	uint8_t dotsize;
 	uint16_t _backlightval; // only for MCP23017
 };
 
+// A panel whose size is known when the sketch is compiled:
+//   LCD_I2C_Fixed<20, 4> lcd(0x27);
+//   lcd.begin();
+// Cursor addresses are constants folded into the call, setCursor<3, 1>()
+// rejects a position off the panel at compile time, and the framebuffer is
+// a member (2 * COLS * ROWS bytes) instead of coming from malloc().
+template <uint8_t COLS, uint8_t ROWS>
+class LCD_I2C_Fixed : public LCD_I2C {
+	static_assert((ROWS >= 1) && (ROWS <= 4), "the HD44780 drives 1 to 4 rows");
+	static_assert((COLS >= 1) && (COLS * ((ROWS > 1) ? 2 : 1) <= 80) && ((ROWS < 3) || (COLS <= 20)),
+	              "the HD44780 has 80 characters of DDRAM, 40 per line");
+public:
+	LCD_I2C_Fixed(uint8_t i2cAddr, I2C_Bus &bus = I2CBus) : LCD_I2C(i2cAddr, bus) {}
+	LCD_I2C_Fixed(MCP23017 &expander) : LCD_I2C(expander) {}
+
+	void begin() { LCD_I2C::begin(COLS, ROWS); }
+
+	static constexpr uint8_t address(uint8_t col, uint8_t row) {
+		return ((row & 1) ? 0x40 : 0) + ((row & 2) ? COLS : 0) + col;
+	}
+	void setCursor(uint8_t col, uint8_t row) {
+		if (row >= ROWS) row = ROWS - 1;
+		moveCursor(col, row, address(col, row));
+	}
+	template <uint8_t COL, uint8_t ROW>
+	void setCursor() {
+		static_assert((COL < COLS) && (ROW < ROWS), "cursor position off the panel");
+		moveCursor(COL, ROW, address(COL, ROW));
+	}
+
+	bool enableFramebuffer() { return LCD_I2C::enableFramebuffer(_cells); }
+
+private:
+	uint8_t _cells[2 * COLS * ROWS];
+};
+
 
 #endif // LCD_I2C_h
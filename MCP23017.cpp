@@ -0,0 +1,207 @@
+#include "MCP23017.h"
+
+#include <string.h>
+#include <stdlib.h>
+#if defined(ARDUINO) && (ARDUINO >= 100) //scl
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+MCP23017 *MCP23017::_first = NULL;
+
+MCP23017::MCP23017(uint8_t addr, I2C_Bus &bus) {
+  _addr = addr;
+  _bus = &bus;
+  _synced = false;
+  _combine = false;
+  _pending = 0;
+  // power-on values until begin() has read the chip
+  memset(_regs, 0, sizeof(_regs));
+  _regs[IODIRA] = _regs[IODIRB] = 0xFF;
+
+  _next = _first;
+  _first = this;
+}
+
+MCP23017::~MCP23017() {
+  for (MCP23017 **e = &_first; *e; e = &(*e)->_next) {
+    if (*e == this) {
+      *e = _next;
+      break;
+    }
+  }
+}
+
+MCP23017 *MCP23017::attach(uint8_t addr, I2C_Bus &bus) {
+  for (MCP23017 *e = _first; e; e = e->_next) {
+    if ((e->_addr == addr) && (e->_bus == &bus)) return e;
+  }
+  return new MCP23017(addr, bus);
+}
+
+uint8_t MCP23017::address() {
+  return _addr;
+}
+
+I2C_Bus &MCP23017::bus() {
+  return *_bus;
+}
+
+void MCP23017::begin() {
+  if (_synced) return;
+  flush();
+
+  // the map is read sequentially, byte mode would toggle between A and B
+  uint8_t iocon = _bus->readRegister(_addr, IOCONA, &_stats);
+  if (iocon & IOCON_SEQOP) _bus->writeRegister(_addr, IOCONA, iocon & ~IOCON_SEQOP, &_stats);
+  // two halves, some Wire implementations have small buffers
+  _synced = (_bus->read(_addr, IODIRA, _regs, MCP23017_REGISTERS / 2, &_stats) == I2C_OK) &&
+            (_bus->read(_addr, MCP23017_REGISTERS / 2, _regs + MCP23017_REGISTERS / 2, MCP23017_REGISTERS / 2, &_stats) == I2C_OK);
+  if (iocon & IOCON_SEQOP) _bus->writeRegister(_addr, IOCONA, iocon, &_stats);
+  _regs[IOCONA] = _regs[IOCONB] = iocon;
+}
+
+// a GPIO write lands in the output latch
+uint8_t MCP23017::latch(uint8_t reg) {
+  return ((reg == GPIOA) || (reg == GPIOB)) ? reg + 2 : reg;
+}
+
+// _pending bit of an output latch, 0 for any other register
+uint8_t MCP23017::port(uint8_t reg) {
+  uint8_t r = latch(reg);
+  return ((r == OLATA) || (r == OLATB)) ? 1 << (r & 1) : 0;
+}
+
+/*********** write combining */
+void MCP23017::setCombining(bool on) {
+  if (!on) flush();
+  _combine = on;
+}
+
+bool MCP23017::flush() {
+  if (!_pending) return false;
+  if (_pending == 3) {
+    _bus->write(_addr, OLATA, _regs + OLATA, 2, &_stats);
+  } else {
+    uint8_t r = (_pending & 1) ? OLATA : OLATB;
+    _bus->writeRegister(_addr, r, _regs[r], &_stats);
+  }
+  _pending = 0;
+  return true;
+}
+
+bool MCP23017::flushAll() {
+  bool sent = false;
+  for (MCP23017 *e = _first; e; e = e->_next) {
+    if (e->flush()) sent = true;
+  }
+  return sent;
+}
+
+/*********** registers */
+uint8_t MCP23017::readRegister(uint8_t reg) {
+  if ((reg >= INTFA) && (reg <= GPIOB)) {
+    // an input reads the pins, an output its latch: pending writes first
+    flush();
+    _regs[reg] = _bus->readRegister(_addr, reg, &_stats);
+  }
+  return _regs[reg];
+}
+
+uint16_t MCP23017::readRegister16(uint8_t reg) {
+  reg &= ~1;
+  flush();
+  // two bytes from A read A then B both sequentially and in byte mode
+  _bus->read(_addr, reg, _regs + reg, 2, &_stats);
+  return _regs[reg] | (_regs[reg + 1] << 8);
+}
+
+void MCP23017::writeRegister(uint8_t reg, uint8_t value) {
+  uint8_t r = latch(reg);
+  if (_combine && port(reg)) {
+    // a later value for the same port replaces a pending one
+    if (_synced && (_regs[r] == value) && !(_pending & port(reg))) return;
+    _regs[r] = value;
+    _pending |= port(reg);
+    return;
+  }
+  if (_synced && (_regs[r] == value)) return;
+  // the latches before anything that depends on them, e.g. IODIR
+  flush();
+  _bus->writeRegister(_addr, reg, value, &_stats);
+  _regs[r] = value;
+  if ((r == IOCONA) || (r == IOCONB)) _regs[IOCONA] = _regs[IOCONB] = value;
+}
+
+void MCP23017::updateRegister(uint8_t reg, uint8_t mask, uint8_t value) {
+  writeRegister(reg, (_regs[latch(reg)] & ~mask) | (value & mask));
+}
+
+void MCP23017::writeRegister16(uint8_t reg, uint16_t value) {
+  reg &= ~1;
+  uint8_t buf[2];
+  buf[0] = value & 0xFF;
+  buf[1] = value >> 8;
+  if (_synced && (_regs[latch(reg)] == buf[0]) && (_regs[latch(reg + 1)] == buf[1]) && !(_pending & port(reg))) return;
+  if (port(reg)) _pending = 0;  // both latches go out now
+  else flush();
+  _bus->write(_addr, reg, buf, 2, &_stats);
+  _regs[latch(reg)] = buf[0];
+  _regs[latch(reg + 1)] = buf[1];
+}
+
+// up to MCP23017_STREAM_MAX values with the partner's in between, returns
+// the bytes in out. A pending partner latch rides along: it is in the gaps
+// anyway, a single value gets it as a second byte. Either way nothing is
+// left pending for the pair.
+uint8_t MCP23017::pack(uint8_t reg, const uint8_t *buf, uint8_t len, uint8_t *out) {
+  uint8_t other = _regs[latch(reg ^ 1)];
+  uint8_t n = 0;
+  for (uint8_t i = 0; (i < MCP23017_STREAM_MAX) && (i < len); i++) {
+    if (i) out[n++] = other;
+    out[n++] = buf[i];
+  }
+  if ((n == 1) && (_pending & port(reg ^ 1))) out[n++] = other;
+  if (port(reg)) _pending = 0;
+  return n;
+}
+
+void MCP23017::stream(uint8_t reg, const uint8_t *buf, uint8_t len) {
+  if (!len) return;
+  uint8_t last = buf[len - 1];
+  if (!(_regs[IOCONA] & IOCON_SEQOP)) {
+    // sequential mode: one transaction per value
+    flush();
+    for (uint8_t i = 0; i < len; i++) _bus->writeRegister(_addr, reg, buf[i], &_stats);
+  } else {
+    if (!port(reg)) flush();
+    uint8_t out[2 * MCP23017_STREAM_MAX - 1];
+    while (len) {
+      uint8_t n = (len < MCP23017_STREAM_MAX) ? len : MCP23017_STREAM_MAX;
+      _bus->write(_addr, reg, out, pack(reg, buf, n, out), &_stats);
+      buf += n;
+      len -= n;
+    }
+  }
+  _regs[latch(reg)] = last;
+}
+
+bool MCP23017::streamAsync(uint8_t reg, const uint8_t *buf, uint8_t len, I2C_Request &req, uint8_t *out) {
+  if (!len || !(_regs[IOCONA] & IOCON_SEQOP) || !req.done()) return false;
+  if (len > MCP23017_STREAM_MAX) len = MCP23017_STREAM_MAX;
+  if (!port(reg)) flush();
+  req.set(_addr, reg, out, pack(reg, buf, len, out), false, &_stats);
+  _bus->submit(req);
+  _regs[latch(reg)] = buf[len - 1];
+  return true;
+}
+
+uint8_t MCP23017::cached(uint8_t reg) {
+  return _regs[reg];
+}
+
+// transport counters and latencies of this expander
+I2C_Stats &MCP23017::getStats() {
+  return _stats;
+}
@@ -0,0 +1,171 @@
+#ifndef MCP23017_h
+#define MCP23017_h
+
+/*
+  MCP23017  shared driver for the board's port expander
+
+  The keypad (bank A) and the LCD (bank B) sit on the same chip. Both go
+  through one MCP23017 object that keeps a copy of all 22 registers, so
+  configuration reads come from RAM, writes that would not change anything
+  are left out and a write to one bank can never disturb the other.
+  Registers are addressed as with IOCON.BANK = 0.
+*/
+
+#include <inttypes.h>
+#include "Wire.h"
+#include "I2C_Bus.h"
+
+#define MCP23017_ADDRESS 0x27  // default i2c address
+#define MCP23017_BASE_ADDRESS 0x20  // A2 A1 A0 select one of eight from here
+#define MCP23017_REGISTERS 22
+
+// values per stream() transaction: with the partner values in between and
+// the register byte they have to fit the Wire transmit buffer
+#define MCP23017_STREAM_MAX (I2C_WIRE_BUFFER / 2)
+
+// Registers
+
+// I/O expander configuration register
+// bit7<R/W-0> BANK: Controls how the registers are addressed
+//     1 = The registers associated with each port are separated into different
+//         banks
+//     0 = The registers are in the same bank (addresses are sequential)
+// bit6<R/W-0> MIRROR: INT Pins Mirror bit
+//     1 = The INT pins are internally connected
+//     0 = The INT pins are not connected. INTA is associated with  PORTA and
+//         INTB is associated with PORTB
+// bit5<R/W-0> SEQOP: Sequential Operation mode bit
+//     1 = Sequential operation disabled, address pointer does not  increment
+//     0 = Sequential operation enabled, address pointer increments
+// bit4<R/W-0> DISSLW: Slew Rate control bit for SDA output
+//     1 = Slew rate disabled
+//     0 = Slew rate enabled
+// bit3<R/W-0> HAEN: Hardware Address Enable bit (MCP23S17 only) (Note 1)
+//     1 = Enables the MCP23S17 address pins.
+//     0 = Disables the MCP23S17 address pins.
+// bit2<R/W-0> ODR: Configures the INT pin as an open-drain output
+//     1 = Open-drain output (overrides the INTPOL bit.)
+//     0 = Active driver output (INTPOL bit sets the polarity.)
+// bit1<R/W-0> INTPOL: This bit sets the polarity of the INT output pin
+//     1 = Active-high
+//     0 = Active-low
+// bit0<U-0> Unimplemented: Read as '0'
+#define IOCONA 0x0A
+#define IOCONB 0x0B
+
+// IOCON bits
+#define IOCON_BANK   0x80
+#define IOCON_MIRROR 0x40
+#define IOCON_SEQOP  0x20
+#define IOCON_DISSLW 0x10
+#define IOCON_HAEN   0x08
+#define IOCON_ODR    0x04
+#define IOCON_INTPOL 0x02
+
+// PIN registers for direction IO<7:0> <R/W-1> (default: 0b11111111)
+#define IODIRA 0x00  //   1 = Pin is configured as an input
+#define IODIRB 0x01  //   0 = Pin is configured as an output
+
+// Input polarity registers  IP<7:0> <R/W-0> (default: 0b00000000)
+#define IPOLA 0x02 //   1 = GPIO register bit reflects the opposite logic state of the input pin
+#define IPOLB 0x03 //   0 = GPIO register bit reflects the same logic state of the input pin
+
+ // Interrupt-on-change control registers   GPINT<7:0> <R/W-0> (default: 0b00000000)
+#define GPINTENA 0x04  //   1 = Enables GPIO input pin for interrupt-on-change event
+#define GPINTENB 0x05  //   0 = Disables GPIO input pin for interrupt-on-change event
+    
+// Default compare registers for interrupt-on-change
+#define DEFVALA 0x06  // DEF<7:0> <R/W-0> (default: 0b00000000)
+#define DEFVALB 0x07    
+
+// Interrupt control register IOC<7:0> <R/W-0> (default: 0b00000000)   
+#define INTCONA 0x08  //   1 = Pin value is compared against the associated bit in the DEFVAL register.
+#define INTCONB 0x09  //   0 = Pin value is compared against the previous pin value.
+
+// Pull-up resistor configuration registers PU<7:0> <R/W-0> (default: 0b00000000)
+#define GPPUA 0x0C  //   1 = Pull-up enabled
+#define GPPUB 0x0D  //   0 = Pull-up disabled
+
+// Interrupt flag registers  INT<7:0> <R-0> (default: 0b00000000)
+#define INTFA 0x0E //   1 = Pin caused interrupt.
+#define INTFB 0x0F //   0 = Interrupt not pending
+
+// Interrupt captured registers  ICP<7:0> <R-x>
+#define INTCAPA 0x10  //   1 = Logic-high
+#define INTCAPB 0x11  //   0 = Logic-low
+
+// Port registers  GP<7:0> <R/W-0> (default: 0b00000000)
+#define GPIOA 0x12  //   1 = Logic-high
+#define GPIOB 0x13  //   0 = Logic-low
+
+// Output latch registers  OL<7:0> <R/W-0> (default: 0b00000000)  
+#define OLATA 0x14  //   1 = Logic-high
+#define OLATB 0x15  //   0 = Logic-low
+
+class MCP23017 {
+public:
+	MCP23017(uint8_t addr, I2C_Bus &bus = I2CBus);
+	// leaves the list attach() and flushAll() walk, pending writes are dropped
+	~MCP23017();
+	// the expander at addr on bus, created on first use so that every
+	// library on the same chip shares one register copy
+	static MCP23017 *attach(uint8_t addr, I2C_Bus &bus = I2CBus);
+	uint8_t address();
+	I2C_Bus &bus();
+
+	// loads the register copy from the chip, only the first call talks to it
+	void begin();
+
+	// IODIR, IPOL, GPINTEN, DEFVAL, INTCON, IOCON, GPPU and OLAT come from the
+	// copy, INTF, INTCAP and GPIO are read from the chip
+	uint8_t readRegister(uint8_t reg);
+	// reads an A/B register pair from the chip, A in the low byte
+	uint16_t readRegister16(uint8_t reg);
+	// writes are skipped when the chip already holds the value
+	void writeRegister(uint8_t reg, uint8_t value);
+	// only the bits set in mask are changed
+	void updateRegister(uint8_t reg, uint8_t mask, uint8_t value);
+	// writes an A/B register pair in one transaction, A in the low byte
+	void writeRegister16(uint8_t reg, uint16_t value);
+	// several values for one register in one transaction (IOCON.SEQOP set):
+	// the pointer toggles between the pair, the other one is rewritten
+	// from the copy in between
+	void stream(uint8_t reg, const uint8_t *buf, uint8_t len);
+	// the same as one queued request: up to MCP23017_STREAM_MAX values are
+	// packed into out (2 * MCP23017_STREAM_MAX - 1 bytes), which has to stay
+	// untouched until req is done. False without IOCON.SEQOP or while req
+	// is still pending.
+	bool streamAsync(uint8_t reg, const uint8_t *buf, uint8_t len, I2C_Request &req, uint8_t *out);
+	// last value written to or read from reg
+	uint8_t cached(uint8_t reg);
+
+	// Write combining: GPIO and OLAT writes only update the copy and go out
+	// with the next transaction to the chip. A stream() carries them in its
+	// partner slots, any other access sends them first, both banks in one
+	// write. So a keypad latch change and a backlight change from the same
+	// loop() cost one transaction. A later value for a port replaces a
+	// pending one, pulses have to go through stream(). Off by default.
+	void setCombining(bool on);
+	// sends pending latch writes now, false if there were none
+	bool flush();
+	// the same for every expander
+	static bool flushAll();
+
+	I2C_Stats &getStats();
+
+private:
+	static uint8_t latch(uint8_t reg);
+	static uint8_t port(uint8_t reg);
+	uint8_t pack(uint8_t reg, const uint8_t *buf, uint8_t len, uint8_t *out);
+	uint8_t _addr;
+	I2C_Bus *_bus;
+	bool _synced;
+	bool _combine;
+	uint8_t _pending;     // bit 0 OLATA, bit 1 OLATB: in the copy, not in the chip
+	uint8_t _regs[MCP23017_REGISTERS];
+	I2C_Stats _stats;
+	MCP23017 *_next;
+	static MCP23017 *_first;
+};
+
+#endif // MCP23017_h
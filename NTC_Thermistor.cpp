@@ -0,0 +1,25 @@
+#include "NTC_Thermistor.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#endif
+
+NTC_Thermistor::NTC_Thermistor(uint8_t pin, const int16_t *table) {
+	_pin = pin;
+	_table = table;
+}
+
+int16_t NTC_Thermistor::read() {
+	return centiCelsius(analogRead(_pin));
+}
+
+// piecewise linear between the two table entries around the code
+int16_t NTC_Thermistor::centiCelsius(uint16_t code, uint8_t extraBits) const {
+	uint8_t shift = NTC_TABLE_SHIFT + extraBits;
+	uint8_t i = code >> shift;
+	if (i >= NTC_TABLE_SIZE - 1) return (int16_t)pgm_read_word(&_table[NTC_TABLE_SIZE - 1]);
+	uint16_t frac = code & ((1 << shift) - 1);
+	int16_t t0 = (int16_t)pgm_read_word(&_table[i]);
+	int16_t t1 = (int16_t)pgm_read_word(&_table[i + 1]);
+	return t0 + (int16_t)(((int32_t)(t1 - t0) * frac) >> shift);
+}
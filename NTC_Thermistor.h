@@ -0,0 +1,103 @@
+#ifndef NTC_Thermistor_h
+#define NTC_Thermistor_h
+
+/*
+  NTC_Thermistor  table based NTC temperature in centi-degrees
+
+  The Steinhart-Hart equation is evaluated by the compiler, not the AVR:
+  NTC_TABLE() builds the temperatures of 65 evenly spaced 10-bit ADC codes
+  into PROGMEM and NTC_Thermistor interpolates between them with integer
+  math, so no float or libm code ends up in the sketch. For the board's
+  10k NTC the interpolation stays within 0.1 C from -20 to 80 C.
+
+  Divider as on the Nano PRO board, the NTC to ground:
+
+    Vin ---- R1 ---+--- R2 (NTC) ---- GND
+                   |
+                   Vo (ADC)
+
+    R2 = Vo * R1 / (1024 - Vo)
+    1/T = A + B * ln(R2) + C * ln(R2)^3,  T in Kelvin
+
+  Usage:
+    NTC_TABLE(ntcTable, 10000, 0.001125308852122, 0.000234711863267, 0.000000085663516);
+    NTC_Thermistor ntc(A6, ntcTable);
+    int16_t t = ntc.read();  // 2345 = 23.45 C
+*/
+
+#include <inttypes.h>
+#if defined(ARDUINO) && (ARDUINO >= 100)
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#define NTC_ADC_BITS    10
+#define NTC_TABLE_SHIFT 4   // ADC codes per table step = 1 << NTC_TABLE_SHIFT
+#define NTC_TABLE_SIZE  ((1 << (NTC_ADC_BITS - NTC_TABLE_SHIFT)) + 1)
+
+/*********** compile time helpers, only used by NTC_TABLE() */
+
+// ln(x) = 2 * atanh((x - 1) / (x + 1)), the argument scaled into [1, 2]
+constexpr double ntcAtanh(double y2, double term, int n) {
+	return (n > 31) ? 0 : term / n + ntcAtanh(y2, term * y2, n + 2);
+}
+
+constexpr double ntcLn(double x) {
+	return (x > 2) ? ntcLn(x / 2) + 0.6931471805599453 :
+	       (x < 1) ? ntcLn(x * 2) - 0.6931471805599453 :
+	       2 * ntcAtanh(((x - 1) / (x + 1)) * ((x - 1) / (x + 1)), (x - 1) / (x + 1), 1);
+}
+
+constexpr double ntcKelvin(double lnR, double a, double b, double c) {
+	return 1 / (a + b * lnR + c * lnR * lnR * lnR);
+}
+
+// the ends of the table are pinned to codes 1 and 1023, R2 is 0 or infinite there
+constexpr double ntcCode(int i) {
+	return (i == 0) ? 1 : ((i << NTC_TABLE_SHIFT) > 1023) ? 1023 : (i << NTC_TABLE_SHIFT);
+}
+
+constexpr int16_t ntcClamp(double centi) {
+	return (centi > 32767) ? 32767 : (centi < -32768) ? -32768 :
+	       (int16_t)((centi < 0) ? centi - 0.5 : centi + 0.5);
+}
+
+constexpr int16_t ntcEntry(int i, double r1, double a, double b, double c) {
+	return ntcClamp((ntcKelvin(ntcLn(ntcCode(i) * r1 / (1024 - ntcCode(i))), a, b, c) - 273.15) * 100);
+}
+
+#define NTC_ROW(i, ...) \
+	ntcEntry(i, __VA_ARGS__),     ntcEntry(i + 1, __VA_ARGS__), \
+	ntcEntry(i + 2, __VA_ARGS__), ntcEntry(i + 3, __VA_ARGS__), \
+	ntcEntry(i + 4, __VA_ARGS__), ntcEntry(i + 5, __VA_ARGS__), \
+	ntcEntry(i + 6, __VA_ARGS__), ntcEntry(i + 7, __VA_ARGS__)
+
+// Defines name[NTC_TABLE_SIZE] in flash, centi-degrees C per table step
+#define NTC_TABLE(name, R1, A, B, C) \
+	const int16_t name[NTC_TABLE_SIZE] PROGMEM = { \
+		NTC_ROW(0, (R1), (A), (B), (C)),  NTC_ROW(8, (R1), (A), (B), (C)), \
+		NTC_ROW(16, (R1), (A), (B), (C)), NTC_ROW(24, (R1), (A), (B), (C)), \
+		NTC_ROW(32, (R1), (A), (B), (C)), NTC_ROW(40, (R1), (A), (B), (C)), \
+		NTC_ROW(48, (R1), (A), (B), (C)), NTC_ROW(56, (R1), (A), (B), (C)), \
+		ntcEntry(64, (R1), (A), (B), (C)) \
+	}
+
+class NTC_Thermistor {
+public:
+	// table from NTC_TABLE()
+	NTC_Thermistor(uint8_t pin, const int16_t *table);
+
+	// analogRead() and convert, centi-degrees C
+	int16_t read();
+
+	// Converts an ADC code, centi-degrees C. extraBits are the bits an
+	// oversampled code has beyond 10, e.g. 2 for a 12-bit code.
+	int16_t centiCelsius(uint16_t code, uint8_t extraBits = 0) const;
+
+private:
+	uint8_t _pin;
+	const int16_t *_table;
+};
+
+#endif // NTC_Thermistor_h
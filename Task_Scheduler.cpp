@@ -0,0 +1,95 @@
+#include "Task_Scheduler.h"
+
+#if defined(ARDUINO) && (ARDUINO >= 100)
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+static inline uint16_t cap16(unsigned long us) {
+	return (us > 0xFFFF) ? 0xFFFF : us;
+}
+
+Task_Scheduler::Task_Scheduler() {
+	for (uint8_t i = 0; i < TASK_SCHEDULER_MAX; i++) _tasks[i].fn = NULL;
+}
+
+int8_t Task_Scheduler::add(unsigned long delayUs, unsigned long periodUs, TaskFunction fn) {
+	if (!fn) return -1;
+	for (uint8_t i = 0; i < TASK_SCHEDULER_MAX; i++) {
+		if (_tasks[i].fn) continue;
+		_tasks[i].fn = fn;
+		_tasks[i].due = micros() + delayUs;
+		_tasks[i].period = periodUs;
+		_tasks[i].stats.reset();
+		return i;
+	}
+	return -1;
+}
+
+int8_t Task_Scheduler::every(unsigned long periodUs, TaskFunction fn, unsigned long offsetUs) {
+	return add(offsetUs, periodUs ? periodUs : 1, fn);
+}
+
+int8_t Task_Scheduler::after(unsigned long delayUs, TaskFunction fn) {
+	return add(delayUs, 0, fn);
+}
+
+void Task_Scheduler::cancel(int8_t id) {
+	if ((id >= 0) && (id < TASK_SCHEDULER_MAX)) _tasks[id].fn = NULL;
+}
+
+// deadlines are compared as signed differences, micros() wraps every 71 minutes
+bool Task_Scheduler::run() {
+	unsigned long now = micros();
+	Task *next = NULL;
+	long nextLate = 0;
+	for (uint8_t i = 0; i < TASK_SCHEDULER_MAX; i++) {
+		Task *t = &_tasks[i];
+		if (!t->fn) continue;
+		long late = (long)(now - t->due);
+		if ((late >= 0) && (!next || (late > nextLate))) {
+			next = t;
+			nextLate = late;
+		}
+	}
+	if (!next) return false;
+
+	TaskFunction fn = next->fn;
+	Task_Stats &s = next->stats;
+	s.runs++;
+	if (cap16(nextLate) > s.lateMax) s.lateMax = cap16(nextLate);
+	if (next->period) {
+		// keep the phase, but drop the periods already missed
+		if ((unsigned long)nextLate >= next->period) {
+			s.overruns++;
+			next->due += next->period * ((unsigned long)nextLate / next->period);
+		}
+		next->due += next->period;
+	}
+
+	unsigned long start = micros();
+	fn();
+	unsigned long took = micros() - start;
+	if (cap16(took) > s.runMax) s.runMax = cap16(took);
+	// a one-shot keeps its slot until it returned, so a task that re-arms
+	// itself with after() cannot get the same slot and these stats
+	if (!next->period) next->fn = NULL;
+	return true;
+}
+
+unsigned long Task_Scheduler::idle() {
+	unsigned long now = micros();
+	unsigned long wait = 0xFFFFFFFFUL;
+	for (uint8_t i = 0; i < TASK_SCHEDULER_MAX; i++) {
+		if (!_tasks[i].fn) continue;
+		long left = (long)(_tasks[i].due - now);
+		if (left <= 0) return 0;
+		if ((unsigned long)left < wait) wait = left;
+	}
+	return wait;
+}
+
+Task_Stats &Task_Scheduler::getStats(int8_t id) {
+	return _tasks[((id >= 0) && (id < TASK_SCHEDULER_MAX)) ? id : 0].stats;
+}
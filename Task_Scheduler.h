@@ -0,0 +1,67 @@
+#ifndef Task_Scheduler_h
+#define Task_Scheduler_h
+
+/*
+  Task_Scheduler  cooperative deadline scheduler
+
+  A fixed table of periodic and one-shot tasks with micros() deadlines,
+  no heap. run() calls the due task with the earliest deadline and
+  returns, so loop() is just
+    tasks.run();
+  Every task keeps its run count, overruns (a whole period missed) and
+  its worst lateness and run time, so update rates can be stated and
+  checked instead of depending on whatever else loop() does.
+
+  Tasks run to completion, a long one delays all others.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+
+#ifndef TASK_SCHEDULER_MAX
+#define TASK_SCHEDULER_MAX 8
+#endif
+
+typedef void (*TaskFunction)();
+
+struct Task_Stats {
+	uint32_t runs;
+	uint16_t overruns;    // periods skipped because the task was too late
+	uint16_t lateMax;     // us after the deadline, capped at 65535
+	uint16_t runMax;      // us in the task function, capped at 65535
+
+	Task_Stats() { reset(); }
+	void reset() { memset(this, 0, sizeof(*this)); }
+};
+
+class Task_Scheduler {
+public:
+	Task_Scheduler();
+
+	// Periodic task, first run after offset us. Returns its id or -1.
+	int8_t every(unsigned long periodUs, TaskFunction fn, unsigned long offsetUs = 0);
+	// One-shot task, its slot is free again after the run
+	int8_t after(unsigned long delayUs, TaskFunction fn);
+	void cancel(int8_t id);
+
+	// Runs the most urgent due task, returns false if none was due
+	bool run();
+
+	// us until the next deadline, 0 if a task is due
+	unsigned long idle();
+
+	Task_Stats &getStats(int8_t id);
+
+private:
+	int8_t add(unsigned long delayUs, unsigned long periodUs, TaskFunction fn);
+
+	struct Task {
+		TaskFunction fn;        // NULL = free slot
+		unsigned long due;      // micros()
+		unsigned long period;   // 0 = one-shot
+		Task_Stats stats;
+	};
+	Task _tasks[TASK_SCHEDULER_MAX];
+};
+
+#endif // Task_Scheduler_h
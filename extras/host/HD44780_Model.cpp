@@ -0,0 +1,168 @@
+#include "HD44780_Model.h"
+
+#include <string.h>
+
+#define PIN_BL 0x01
+#define PIN_EN 0x20
+#define PIN_RW 0x40
+#define PIN_RS 0x80
+
+#define EXEC_NS      37000UL
+#define EXEC_SLOW_NS 1520000UL
+
+HD44780_Model::HD44780_Model(MCP23017_Model &chip) {
+  _cols = 16;
+  _rows = 2;
+  reset();
+  _levels = chip.pins() >> 8;
+  chip.addListener(pins, this);
+}
+
+void HD44780_Model::reset() {
+  memset(_ddram, ' ', sizeof(_ddram));
+  memset(_cgram, 0, sizeof(_cgram));
+  _ac = 0;
+  _cgMode = false;
+  _eightBit = true;
+  _twoLine = false;
+  _highNibble = true;
+  _nibble = 0;
+  _entry = 0x02;
+  _control = 0;
+  _shift = 0;
+  _backlight = false;
+  _busyUntil = 0;
+  resetCounters();
+}
+
+void HD44780_Model::begin(uint8_t cols, uint8_t rows) {
+  _cols = (cols > 40) ? 40 : cols;
+  _rows = (rows > 4) ? 4 : rows;
+}
+
+void HD44780_Model::resetCounters() {
+  _commands = _data = _strobes = _violations = 0;
+}
+
+const char *HD44780_Model::line(uint8_t row) {
+  static char none[1];
+  if (row >= _rows) return none;
+  char *text = _line[row];
+  // rows 2 and 3 of a four line panel continue rows 0 and 1
+  uint8_t base = (row & 1) ? 0x40 : 0;
+  uint8_t first = (row & 2) ? _cols : 0;
+  for (uint8_t c = 0; c < _cols; c++) {
+    int pos = (first + c + 40 - (_shift % 40)) % 40;
+    uint8_t ch = _ddram[base + pos];
+    text[c] = (ch < 16) ? '0' + (ch & 7) : (ch >= 0x20 && ch < 0x7F) ? ch : '?';
+  }
+  text[_cols] = 0;
+  return text;
+}
+
+/*********** pins */
+void HD44780_Model::pins(void *ctx, uint8_t port, uint8_t levels) {
+  if (port != 1) return;
+  HD44780_Model *lcd = (HD44780_Model *)ctx;
+  lcd->_backlight = levels & PIN_BL;
+  if ((lcd->_levels & PIN_EN) && !(levels & PIN_EN)) lcd->strobe(lcd->_levels);
+  lcd->_levels = levels;
+}
+
+// falling edge of EN, levels are the ones set up while EN was high
+void HD44780_Model::strobe(uint8_t levels) {
+  if (levels & PIN_RW) return;  // reads are not modelled
+  _strobes++;
+  uint8_t nibble = (levels >> 1) & 0x0F;
+  bool rs = levels & PIN_RS;
+  if (_eightBit) {
+    // D0-D3 are not wired and read as 0
+    execute(rs, nibble << 4);
+    return;
+  }
+  if (_highNibble) {
+    _nibble = nibble;
+    _highNibble = false;
+    return;
+  }
+  _highNibble = true;
+  execute(rs, (_nibble << 4) | nibble);
+}
+
+/*********** execution */
+void HD44780_Model::execute(bool rs, uint8_t value) {
+  uint64_t now = Sim::now();
+  if (now < _busyUntil) _violations++;
+  uint64_t ns = EXEC_NS;
+  if (rs) {
+    _data++;
+    if (_cgMode) _cgram[_ac & 0x3F] = value;
+    else _ddram[_ac & 0x7F] = value;
+    step();
+    if (!_cgMode && (_entry & 0x01)) _shift += (_entry & 0x02) ? -1 : 1;
+  } else {
+    _commands++;
+    if ((value == 0x01) || ((value & 0xFE) == 0x02)) ns = EXEC_SLOW_NS;
+    instruction(value);
+  }
+  _busyUntil = now + ns;
+}
+
+void HD44780_Model::instruction(uint8_t value) {
+  if (value & 0x80) {
+    _ac = value & 0x7F;
+    _cgMode = false;
+  } else if (value & 0x40) {
+    _ac = value & 0x3F;
+    _cgMode = true;
+  } else if (value & 0x20) {
+    _eightBit = value & 0x10;
+    _twoLine = value & 0x08;
+    _highNibble = true;
+  } else if (value & 0x10) {
+    if (value & 0x08) _shift += (value & 0x04) ? 1 : -1;
+    else {
+      uint8_t entry = _entry;
+      _entry = (value & 0x04) ? 0x02 : 0x00;
+      step();
+      _entry = entry;
+    }
+  } else if (value & 0x08) {
+    _control = value & 0x07;
+  } else if (value & 0x04) {
+    _entry = value & 0x03;
+  } else if (value & 0x02) {
+    _ac = 0;
+    _cgMode = false;
+    _shift = 0;
+  } else if (value & 0x01) {
+    memset(_ddram, ' ', sizeof(_ddram));
+    _ac = 0;
+    _cgMode = false;
+    _shift = 0;
+    _entry |= 0x02;
+  }
+}
+
+// moves the address counter as the entry mode says; DDRAM wraps within
+// the 40 cells of each line, line 0 continues on line 1 and back
+void HD44780_Model::step() {
+  bool inc = _entry & 0x02;
+  if (_cgMode) {
+    _ac = (_ac + (inc ? 1 : -1)) & 0x3F;
+    return;
+  }
+  if (!_twoLine) {
+    _ac = inc ? ((_ac >= 0x4F) ? 0 : _ac + 1) : (_ac ? _ac - 1 : 0x4F);
+    return;
+  }
+  if (inc) {
+    if (_ac == 0x27) _ac = 0x40;
+    else if (_ac == 0x67) _ac = 0x00;
+    else _ac++;
+  } else {
+    if (_ac == 0x40) _ac = 0x27;
+    else if (_ac == 0x00) _ac = 0x67;
+    else _ac--;
+  }
+}
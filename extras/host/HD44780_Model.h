@@ -0,0 +1,67 @@
+#ifndef HD44780_Model_h
+#define HD44780_Model_h
+
+/*
+  HD44780_Model  the LCD controller on bank B of an MCP23017_Model
+
+  Wired as LCD_I2C drives it: BL on B0, D4-D7 on B1-B4, EN on B5, RW on B6
+  and RS on B7. The controller latches on the falling edge of EN, starts in
+  8-bit mode after power-up and follows the reset sequence into 4-bit mode.
+  Every instruction keeps it busy for its execution time (37 us, 1.52 ms
+  for clear and home); a strobe that arrives while it is still busy is
+  counted as a violation, the data is taken anyway.
+*/
+
+#include "MCP23017_Model.h"
+
+class HD44780_Model {
+public:
+	HD44780_Model(MCP23017_Model &chip);
+
+	// power-on reset, panel geometry only matters for line()
+	void reset();
+	void begin(uint8_t cols, uint8_t rows);
+
+	// text of a visible row, cols characters and a terminating 0, a CGRAM
+	// character (codes 0-7 and their mirror 8-15) as its slot digit
+	const char *line(uint8_t row);
+	uint8_t ddram(uint8_t address) const { return _ddram[address & 0x7F]; }
+	uint8_t cgram(uint8_t address) const { return _cgram[address & 0x3F]; }
+	uint8_t address() const { return _ac; }
+	bool fourBit() const { return !_eightBit; }
+	bool displayOn() const { return _control & 0x04; }
+	bool backlight() const { return _backlight; }
+
+	uint32_t commands() const { return _commands; }
+	uint32_t dataWrites() const { return _data; }
+	uint32_t strobes() const { return _strobes; }
+	uint32_t violations() const { return _violations; }
+	void resetCounters();
+
+private:
+	static void pins(void *ctx, uint8_t port, uint8_t levels);
+	void strobe(uint8_t levels);
+	void execute(bool rs, uint8_t value);
+	void instruction(uint8_t value);
+	void step();
+
+	uint8_t _ddram[128];
+	uint8_t _cgram[64];
+	char _line[4][41];    // per row, so several lines can be used at once
+	uint8_t _cols, _rows;
+	uint8_t _ac;           // address counter
+	bool _cgMode;          // the counter points into CGRAM
+	bool _eightBit;
+	bool _twoLine;
+	bool _highNibble;      // a 4-bit transfer is half done
+	uint8_t _nibble;
+	uint8_t _entry, _control;
+	int8_t _shift;         // display shift
+	bool _backlight;
+	uint8_t _levels;       // last bank B levels
+	uint64_t _busyUntil;   // ns
+
+	uint32_t _commands, _data, _strobes, _violations;
+};
+
+#endif // HD44780_Model_h
@@ -0,0 +1,158 @@
+#include "Keypad.h"
+
+Keypad::Keypad(char *userKeymap, byte *row, byte *col, byte numRows, byte numCols) {
+  rowPins = row;
+  columnPins = col;
+  sizeKpd.rows = numRows;
+  sizeKpd.columns = numCols;
+  begin(userKeymap);
+  setDebounceTime(10);
+  setHoldTime(500);
+  keypadEventListener = 0;
+  startTime = 0;
+  single_key = false;
+  holdTimer = 0;
+  memset(bitMap, 0, sizeof(bitMap));
+}
+
+void Keypad::begin(char *userKeymap) {
+  keymap = userKeymap;
+}
+
+char Keypad::getKey() {
+  single_key = true;
+  if (getKeys() && key[0].stateChanged && (key[0].kstate == PRESSED)) return key[0].kchar;
+  single_key = false;
+  return NO_KEY;
+}
+
+bool Keypad::getKeys() {
+  bool keyActivity = false;
+  // scans at most once per debounce time
+  if ((millis() - startTime) > debounceTime) {
+    scanKeys();
+    keyActivity = updateList();
+    startTime = millis();
+  }
+  return keyActivity;
+}
+
+void Keypad::scanKeys() {
+  for (byte r = 0; r < sizeKpd.rows; r++) pin_mode(rowPins[r], INPUT_PULLUP);
+  for (byte c = 0; c < sizeKpd.columns; c++) {
+    pin_mode(columnPins[c], OUTPUT);
+    pin_write(columnPins[c], LOW);
+    for (byte r = 0; r < sizeKpd.rows; r++) bitWrite(bitMap[r], c, !pin_read(rowPins[r]));
+    pin_write(columnPins[c], HIGH);
+    pin_mode(columnPins[c], INPUT);
+  }
+}
+
+bool Keypad::updateList() {
+  bool anyActivity = false;
+  for (byte i = 0; i < LIST_MAX; i++) {
+    if (key[i].kstate == IDLE) {
+      key[i].kchar = NO_KEY;
+      key[i].kcode = -1;
+      key[i].stateChanged = false;
+    }
+  }
+  for (byte r = 0; r < sizeKpd.rows; r++) {
+    for (byte c = 0; c < sizeKpd.columns; c++) {
+      boolean button = bitRead(bitMap[r], c);
+      int keyCode = r * sizeKpd.columns + c;
+      char keyChar = keymap[keyCode];
+      int idx = findInList(keyCode);
+      if (idx > -1) nextKeyState(idx, button);
+      if ((idx == -1) && button) {
+        for (byte i = 0; i < LIST_MAX; i++) {
+          if (key[i].kchar == NO_KEY) {
+            key[i].kchar = keyChar;
+            key[i].kcode = keyCode;
+            key[i].kstate = IDLE;
+            nextKeyState(i, button);
+            break;
+          }
+        }
+      }
+    }
+  }
+  for (byte i = 0; i < LIST_MAX; i++) {
+    if (key[i].stateChanged) anyActivity = true;
+  }
+  return anyActivity;
+}
+
+void Keypad::nextKeyState(byte idx, boolean button) {
+  key[idx].stateChanged = false;
+  switch (key[idx].kstate) {
+    case IDLE:
+      if (button == CLOSED) {
+        transitionTo(idx, PRESSED);
+        holdTimer = millis();
+      }
+      break;
+    case PRESSED:
+      if ((millis() - holdTimer) > holdTime) transitionTo(idx, HOLD);
+      else if (button == OPEN) transitionTo(idx, RELEASED);
+      break;
+    case HOLD:
+      if (button == OPEN) transitionTo(idx, RELEASED);
+      break;
+    case RELEASED:
+      transitionTo(idx, IDLE);
+      break;
+  }
+}
+
+void Keypad::transitionTo(byte idx, KeyState nextState) {
+  key[idx].kstate = nextState;
+  key[idx].stateChanged = true;
+  if (!keypadEventListener) return;
+  if (!single_key || (idx == 0)) keypadEventListener(key[idx].kchar);
+}
+
+KeyState Keypad::getState() {
+  return key[0].kstate;
+}
+
+bool Keypad::isPressed(char keyChar) {
+  for (byte i = 0; i < LIST_MAX; i++) {
+    if ((key[i].kchar == keyChar) && (key[i].kstate == PRESSED) && key[i].stateChanged) return true;
+  }
+  return false;
+}
+
+void Keypad::setDebounceTime(uint debounce) {
+  debounceTime = debounce < 1 ? 1 : debounce;
+}
+
+void Keypad::setHoldTime(uint hold) {
+  holdTime = hold;
+}
+
+void Keypad::addEventListener(void (*listener)(char)) {
+  keypadEventListener = listener;
+}
+
+int Keypad::findInList(char keyChar) {
+  for (byte i = 0; i < LIST_MAX; i++) {
+    if (key[i].kchar == keyChar) return i;
+  }
+  return -1;
+}
+
+int Keypad::findInList(int keyCode) {
+  for (byte i = 0; i < LIST_MAX; i++) {
+    if (key[i].kcode == keyCode) return i;
+  }
+  return -1;
+}
+
+bool Keypad::keyStateChanged() {
+  return key[0].stateChanged;
+}
+
+byte Keypad::numKeys() {
+  return sizeof(key) / sizeof(Key);
+}
@@ -0,0 +1,67 @@
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+/*
+  Host stand-in for the Keypad library (3.1), same interface and the same
+  scan: rows are INPUT_PULLUP, each column in turn is driven low through
+  the pin_mode()/pin_write()/pin_read() hooks and the rows are read.
+*/
+
+#include "Key.h"
+
+typedef char KeypadEvent;
+typedef unsigned long ulong;
+
+typedef struct {
+	byte rows;
+	byte columns;
+} KeypadSize;
+
+#define LIST_MAX 10
+#define MAPSIZE 10
+#define makeKeymap(x) ((char*)x)
+
+class Keypad : public Key {
+public:
+	Keypad(char *userKeymap, byte *row, byte *col, byte numRows, byte numCols);
+	virtual ~Keypad() {}
+
+	virtual void pin_mode(byte pinNum, byte mode) { pinMode(pinNum, mode); }
+	virtual void pin_write(byte pinNum, boolean level) { digitalWrite(pinNum, level); }
+	virtual int  pin_read(byte pinNum) { return digitalRead(pinNum); }
+
+	uint bitMap[MAPSIZE];
+	Key key[LIST_MAX];
+	unsigned long holdTimer;
+
+	char getKey();
+	bool getKeys();
+	KeyState getState();
+	void begin(char *userKeymap);
+	bool isPressed(char keyChar);
+	void setDebounceTime(uint);
+	void setHoldTime(uint);
+	void addEventListener(void (*listener)(char));
+	int findInList(char keyChar);
+	int findInList(int keyCode);
+	bool keyStateChanged();
+	byte numKeys();
+
+private:
+	unsigned long startTime;
+	char *keymap;
+	byte *rowPins;
+	byte *columnPins;
+	KeypadSize sizeKpd;
+	uint debounceTime;
+	uint holdTime;
+	bool single_key;
+
+	void scanKeys();
+	bool updateList();
+	void nextKeyState(byte n, boolean button);
+	void transitionTo(byte n, KeyState nextState);
+	void (*keypadEventListener)(char);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "Keypad_Model.h"
+
+#include <string.h>
+
+Keypad_Model::Keypad_Model(MCP23017_Model &chip, const uint8_t *rowPins, const uint8_t *colPins, uint8_t rows, uint8_t cols)
+  : _chip(chip) {
+  _rows = (rows > KEYPAD_MODEL_MAX) ? KEYPAD_MODEL_MAX : rows;
+  _cols = (cols > KEYPAD_MODEL_MAX) ? KEYPAD_MODEL_MAX : cols;
+  memcpy(_rowPins, rowPins, _rows);
+  memcpy(_colPins, colPins, _cols);
+  memset(_down, 0, sizeof(_down));
+  _chip.setResolver(resolve, this);
+}
+
+void Keypad_Model::press(uint8_t row, uint8_t col) {
+  if ((row >= _rows) || (col >= _cols)) return;
+  _down[row] |= 1 << col;
+  _chip.update();
+}
+
+void Keypad_Model::release(uint8_t row, uint8_t col) {
+  if ((row >= _rows) || (col >= _cols)) return;
+  _down[row] &= ~(1 << col);
+  _chip.update();
+}
+
+void Keypad_Model::releaseAll() {
+  memset(_down, 0, sizeof(_down));
+  _chip.update();
+}
+
+bool Keypad_Model::pressed(uint8_t row, uint8_t col) const {
+  return (row < _rows) && (col < _cols) && (_down[row] & (1 << col));
+}
+
+void Keypad_Model::resolve(void *ctx, const MCP23017_Model &chip, uint16_t *mask, uint16_t *level) {
+  Keypad_Model *k = (Keypad_Model *)ctx;
+  uint16_t out = chip.outputs();
+  uint16_t latch = chip.reg(0x14) | (chip.reg(0x15) << 8);
+  uint16_t low = out & ~latch;  // pins driving low
+  for (uint8_t r = 0; r < k->_rows; r++) {
+    for (uint8_t c = 0; c < k->_cols; c++) {
+      if (!(k->_down[r] & (1 << c))) continue;
+      uint16_t rp = 1 << k->_rowPins[r];
+      uint16_t cp = 1 << k->_colPins[c];
+      if ((low & cp) && !(out & rp)) *mask |= rp;
+      if ((low & rp) && !(out & cp)) *mask |= cp;
+    }
+  }
+  *level = 0;
+}
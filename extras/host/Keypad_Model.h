@@ -0,0 +1,35 @@
+#ifndef Keypad_Model_h
+#define Keypad_Model_h
+
+/*
+  Keypad_Model  a key matrix on MCP23017_Model pins
+
+  A pressed key connects its row and column pin: when one of them is an
+  output driving low and the other an input, the input reads low.
+*/
+
+#include "MCP23017_Model.h"
+
+#define KEYPAD_MODEL_MAX 8  // rows and columns
+
+class Keypad_Model {
+public:
+	// pins are expander pins, 0-7 bank A, 8-15 bank B
+	Keypad_Model(MCP23017_Model &chip, const uint8_t *rowPins, const uint8_t *colPins, uint8_t rows, uint8_t cols);
+
+	void press(uint8_t row, uint8_t col);
+	void release(uint8_t row, uint8_t col);
+	void releaseAll();
+	bool pressed(uint8_t row, uint8_t col) const;
+
+private:
+	static void resolve(void *ctx, const MCP23017_Model &chip, uint16_t *mask, uint16_t *level);
+
+	MCP23017_Model &_chip;
+	uint8_t _rowPins[KEYPAD_MODEL_MAX];
+	uint8_t _colPins[KEYPAD_MODEL_MAX];
+	uint8_t _rows, _cols;
+	uint8_t _down[KEYPAD_MODEL_MAX];  // bit col of row
+};
+
+#endif // Keypad_Model_h
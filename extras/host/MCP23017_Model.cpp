@@ -0,0 +1,196 @@
+#include "MCP23017_Model.h"
+#include "Arduino.h"
+
+// registers by their BANK = 0 address
+enum {
+  IODIR = 0x00, IPOL = 0x02, GPINTEN = 0x04, DEFVAL = 0x06, INTCON = 0x08,
+  IOCON = 0x0A, GPPU = 0x0C, INTF = 0x0E, INTCAP = 0x10, GPIO = 0x12, OLAT = 0x14
+};
+#define REGISTERS 22
+
+#define IOCON_BANK   0x80
+#define IOCON_MIRROR 0x40
+#define IOCON_SEQOP  0x20
+#define IOCON_ODR    0x04
+#define IOCON_INTPOL 0x02
+
+MCP23017_Model::MCP23017_Model(uint8_t address) : Sim::I2CDevice(address) {
+  _resolver = NULL;
+  _resolverCtx = NULL;
+  for (uint8_t i = 0; i < MCP23017_MODEL_LISTENERS; i++) _listeners[i] = NULL;
+  _intA = _intB = -1;
+  reset();
+}
+
+void MCP23017_Model::reset() {
+  memset(_regs, 0, sizeof(_regs));
+  _regs[IODIR] = _regs[IODIR + 1] = 0xFF;
+  _pins = 0xFFFF;
+  _pointer = 0;
+  _gotPointer = false;
+  _wrapped = false;
+  _writes = _reads = _wrapReads = 0;
+  update();
+}
+
+void MCP23017_Model::setResolver(MCP23017_Resolver fn, void *ctx) {
+  _resolver = fn;
+  _resolverCtx = ctx;
+  update();
+}
+
+bool MCP23017_Model::addListener(MCP23017_Listener fn, void *ctx) {
+  for (uint8_t i = 0; i < MCP23017_MODEL_LISTENERS; i++) {
+    if (_listeners[i]) continue;
+    _listeners[i] = fn;
+    _listenerCtx[i] = ctx;
+    return true;
+  }
+  return false;
+}
+
+void MCP23017_Model::connectInt(int intA, int intB) {
+  _intA = intA;
+  _intB = intB;
+  intPins();
+}
+
+/*********** addressing */
+
+// BANK = 1 puts port B 0x10 above port A, with the registers one apart
+uint8_t MCP23017_Model::index(uint8_t address) const {
+  if (!(_regs[IOCON] & IOCON_BANK)) return (address < REGISTERS) ? address : 0xFF;
+  uint8_t r = address & 0x0F;
+  if ((address & 0xE0) || (r >= REGISTERS / 2)) return 0xFF;
+  return 2 * r + ((address >> 4) & 1);
+}
+
+// Sequential mode steps through the map. Byte mode (SEQOP) keeps the
+// pointer with BANK = 1 and toggles between the A/B pair with BANK = 0.
+void MCP23017_Model::advancePointer() {
+  bool bank = _regs[IOCON] & IOCON_BANK;
+  if (_regs[IOCON] & IOCON_SEQOP) {
+    if (!bank) _pointer ^= 1;
+  } else if (!bank) {
+    _pointer = (_pointer + 1) % REGISTERS;
+    if (!_pointer) _wrapped = true;
+  } else {
+    _pointer++;
+    if ((_pointer & 0x0F) >= REGISTERS / 2) _pointer = (_pointer & 0x10) ? 0x00 : 0x10;
+  }
+}
+
+/*********** Sim::I2CDevice */
+bool MCP23017_Model::start(bool read) {
+  if (!read) _gotPointer = false;
+  return true;
+}
+
+bool MCP23017_Model::write(uint8_t value) {
+  if (!_gotPointer) {
+    _pointer = value;
+    _wrapped = false;
+    _gotPointer = true;
+    return true;
+  }
+  uint8_t idx = index(_pointer);
+  if (idx != 0xFF) writeReg(idx, value);
+  advancePointer();
+  _writes++;
+  return true;
+}
+
+uint8_t MCP23017_Model::read() {
+  uint8_t idx = index(_pointer);
+  uint8_t value = (idx != 0xFF) ? readReg(idx) : 0;
+  if (_wrapped) _wrapReads++;
+  advancePointer();
+  _reads++;
+  return value;
+}
+
+void MCP23017_Model::stop() {
+}
+
+/*********** registers */
+void MCP23017_Model::writeReg(uint8_t idx, uint8_t value) {
+  uint8_t base = idx & ~1;
+  if ((base == INTF) || (base == INTCAP)) return;  // read-only
+  if (base == GPIO) idx += 2;                      // lands in the latch
+  if (base == IOCON) {
+    _regs[IOCON] = _regs[IOCON + 1] = value & 0xFE;
+    intPins();
+    return;
+  }
+  _regs[idx] = value;
+  update();
+}
+
+uint8_t MCP23017_Model::readReg(uint8_t idx) {
+  uint8_t port = idx & 1;
+  uint8_t base = idx & ~1;
+  if (base == GPIO) {
+    uint8_t inputs = _regs[IODIR + port];
+    _regs[idx] = (uint8_t)(_pins >> (8 * port)) ^ (_regs[IPOL + port] & inputs);
+  }
+  uint8_t value = _regs[idx];
+  if ((base == GPIO) || (base == INTCAP)) {
+    // clears the interrupt, a pin still away from DEFVAL raises it again
+    _regs[INTF + port] = 0;
+    compareDefval(port);
+    intPins();
+  }
+  return value;
+}
+
+/*********** pins */
+void MCP23017_Model::update() {
+  uint16_t out = outputs();
+  uint16_t latch = _regs[OLAT] | (_regs[OLAT + 1] << 8);
+  uint16_t mask = 0, level = 0;
+  if (_resolver) _resolver(_resolverCtx, *this, &mask, &level);
+  // undriven inputs read high, pulled up or floating
+  uint16_t in = (mask & level) | (uint16_t)~mask;
+  uint16_t pins = (latch & out) | (in & ~out);
+  uint16_t changed = pins ^ _pins;
+  _pins = pins;
+
+  for (uint8_t port = 0; port < 2; port++) {
+    uint8_t c = changed >> (8 * port);
+    if (c) {
+      for (uint8_t i = 0; i < MCP23017_MODEL_LISTENERS; i++) {
+        if (_listeners[i]) _listeners[i](_listenerCtx[i], port, _pins >> (8 * port));
+      }
+    }
+    // interrupt-on-change compares against the previous level
+    uint8_t enabled = _regs[GPINTEN + port] & _regs[IODIR + port] & ~_regs[INTCON + port];
+    uint8_t fired = c & enabled;
+    if (fired && !_regs[INTF + port]) {
+      _regs[INTF + port] = fired;
+      _regs[INTCAP + port] = (uint8_t)(_pins >> (8 * port)) ^ (_regs[IPOL + port] & _regs[IODIR + port]);
+    }
+    compareDefval(port);
+  }
+  intPins();
+}
+
+// the DEFVAL comparison, active as long as a pin differs
+void MCP23017_Model::compareDefval(uint8_t port) {
+  if (_regs[INTF + port]) return;
+  uint8_t inputs = _regs[IODIR + port];
+  uint8_t value = (uint8_t)(_pins >> (8 * port)) ^ (_regs[IPOL + port] & inputs);
+  uint8_t enabled = _regs[GPINTEN + port] & inputs & _regs[INTCON + port];
+  uint8_t fired = (value ^ _regs[DEFVAL + port]) & enabled;
+  if (!fired) return;
+  _regs[INTF + port] = fired;
+  _regs[INTCAP + port] = value;
+}
+
+void MCP23017_Model::intPins() {
+  bool a = _regs[INTF] != 0;
+  bool b = _regs[INTF + 1] != 0;
+  if (_regs[IOCON] & IOCON_MIRROR) a = b = a || b;
+  bool high = (_regs[IOCON] & IOCON_INTPOL) && !(_regs[IOCON] & IOCON_ODR);
+  if (_intA >= 0) Sim::setPin(_intA, a == high);
+  if (_intB >= 0) Sim::setPin(_intB, b == high);
+}
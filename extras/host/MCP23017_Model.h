@@ -0,0 +1,84 @@
+#ifndef MCP23017_Model_h
+#define MCP23017_Model_h
+
+/*
+  MCP23017_Model  behavioural model of the port expander
+
+  Register file with both IOCON.BANK layouts, the address pointer as
+  IOCON.SEQOP and BANK move it, output latches, pull-ups, input polarity
+  and interrupt-on-change with INTF/INTCAP and the INTA/INTB pins.
+
+  Whatever is wired to the pins takes part through two hooks: a resolver
+  that tells which input pins the outside drives and to what level (see
+  Keypad_Model), and listeners that see every change of a port's pin
+  levels with the simulated time it happened (see HD44780_Model).
+*/
+
+#include "Sim.h"
+
+class MCP23017_Model;
+
+// outside drive of the pins: bits in mask are driven to the bits in level
+typedef void (*MCP23017_Resolver)(void *ctx, const MCP23017_Model &chip, uint16_t *mask, uint16_t *level);
+// a port's pin levels changed
+typedef void (*MCP23017_Listener)(void *ctx, uint8_t port, uint8_t levels);
+
+#define MCP23017_MODEL_LISTENERS 4
+
+class MCP23017_Model : public Sim::I2CDevice {
+public:
+	MCP23017_Model(uint8_t address = 0x27);
+
+	// power-on reset
+	void reset();
+
+	// register by its BANK = 0 address, whatever IOCON.BANK is
+	uint8_t reg(uint8_t index) const { return _regs[index]; }
+	// pin levels, bank A in the low byte
+	uint16_t pins() const { return _pins; }
+	// pins configured as outputs, bank A in the low byte
+	uint16_t outputs() const { return (uint16_t)~(_regs[0x00] | (_regs[0x01] << 8)); }
+
+	void setResolver(MCP23017_Resolver fn, void *ctx);
+	bool addListener(MCP23017_Listener fn, void *ctx);
+	// Arduino pins INTA/INTB are wired to, -1 for none
+	void connectInt(int intA, int intB = -1);
+
+	// recompute the pins after the outside changed, e.g. a key was pressed
+	void update();
+
+	// Sim::I2CDevice
+	bool start(bool read);
+	bool write(uint8_t value);
+	uint8_t read();
+	void stop();
+
+	// register writes and reads over the bus
+	uint32_t writes() const { return _writes; }
+	uint32_t reads() const { return _reads; }
+	// sequential reads that ran past the last register and started over
+	uint32_t wrapReads() const { return _wrapReads; }
+
+private:
+	uint8_t index(uint8_t address) const;
+	void advancePointer();
+	void writeReg(uint8_t idx, uint8_t value);
+	uint8_t readReg(uint8_t idx);
+	void compareDefval(uint8_t port);
+	void intPins();
+
+	uint8_t _regs[22];
+	uint16_t _pins;
+	uint8_t _pointer;      // register address as the master sent it
+	bool _gotPointer;      // first byte of a write transaction was the address
+	bool _wrapped;         // the pointer ran past the end since it was set
+	uint32_t _writes, _reads, _wrapReads;
+	int _intA, _intB;
+
+	MCP23017_Resolver _resolver;
+	void *_resolverCtx;
+	MCP23017_Listener _listeners[MCP23017_MODEL_LISTENERS];
+	void *_listenerCtx[MCP23017_MODEL_LISTENERS];
+};
+
+#endif // MCP23017_Model_h
@@ -0,0 +1,177 @@
+#include "Sim.h"
+#include "Arduino.h"
+
+#include <string.h>
+
+namespace Sim {
+
+static uint64_t clockNs = 0;
+static uint32_t callNs = 4000;
+static uint32_t pinNs = 3000;
+static uint32_t busHz = 100000;
+static BusStats busStats;
+static uint8_t pinLow[SIM_PINS];  // zero, all pins high, before any constructor runs
+static uint16_t analogs[SIM_PINS];
+static uint8_t modes[SIM_PINS];    // INPUT
+static uint8_t outputs[SIM_PINS];  // LOW
+static PinListener pinListener = NULL;
+static void *pinContext = NULL;
+static I2CDevice *devices = NULL;
+
+/*********** devices */
+I2CDevice::I2CDevice(uint8_t address) {
+  _address = address;
+  _next = devices;
+  devices = this;
+}
+
+I2CDevice::~I2CDevice() {
+  for (I2CDevice **d = &devices; *d; d = &(*d)->_next) {
+    if (*d == this) {
+      *d = _next;
+      break;
+    }
+  }
+}
+
+I2CDevice *device(uint8_t address) {
+  for (I2CDevice *d = devices; d; d = d->_next) {
+    if (d->_address == address) return d;
+  }
+  return NULL;
+}
+
+void BusStats::reset() {
+  memset(this, 0, sizeof(*this));
+}
+
+/*********** clock */
+uint64_t now() {
+  return clockNs;
+}
+
+void advance(uint64_t ns) {
+  clockNs += ns;
+}
+
+void reset() {
+  clockNs = 0;
+  busStats.reset();
+  memset(pinLow, 0, sizeof(pinLow));
+  memset(analogs, 0, sizeof(analogs));
+  memset(modes, 0, sizeof(modes));
+  memset(outputs, 0, sizeof(outputs));
+}
+
+void setCallCost(uint32_t ns) {
+  callNs = ns;
+}
+
+uint32_t callCost() {
+  return callNs;
+}
+
+void setPinCost(uint32_t ns) {
+  pinNs = ns;
+}
+
+uint32_t pinCost() {
+  return pinNs;
+}
+
+/*********** bus */
+void setBusClock(uint32_t hz) {
+  if (hz) busHz = hz;
+}
+
+uint32_t busClock() {
+  return busHz;
+}
+
+uint64_t bitTime() {
+  return 1000000000ULL / busHz;
+}
+
+BusStats &bus() {
+  return busStats;
+}
+
+/*********** pins */
+void setPin(uint8_t p, uint8_t level) {
+  if (p < SIM_PINS) pinLow[p] = !level;
+}
+
+uint8_t pin(uint8_t p) {
+  return ((p < SIM_PINS) && pinLow[p]) ? LOW : HIGH;
+}
+
+uint8_t mode(uint8_t p) {
+  return (p < SIM_PINS) ? modes[p] : INPUT;
+}
+
+uint8_t output(uint8_t p) {
+  return (p < SIM_PINS) ? outputs[p] : LOW;
+}
+
+void setPinListener(PinListener fn, void *ctx) {
+  pinListener = fn;
+  pinContext = ctx;
+}
+
+// the sketch changed a pin
+static void pinChanged(uint8_t p) {
+  if (pinListener) pinListener(pinContext, p);
+}
+
+// by channel, A6 and 6 are the same input as for analogRead()
+void setAnalog(uint8_t p, uint16_t value) {
+  if (p >= A0) p -= A0;
+  if (p < SIM_PINS) analogs[p] = value;
+}
+
+uint16_t analog(uint8_t p) {
+  if (p >= A0) p -= A0;
+  return (p < SIM_PINS) ? analogs[p] : 0;
+}
+
+} // namespace Sim
+
+/*********** Arduino core on the simulated clock */
+unsigned long micros() {
+  Sim::advance(Sim::callCost());
+  return Sim::now() / 1000;
+}
+
+unsigned long millis() {
+  Sim::advance(Sim::callCost());
+  return Sim::now() / 1000000;
+}
+
+void delay(unsigned long ms) {
+  Sim::advance(ms * 1000000ULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+  Sim::advance(us * 1000ULL);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < SIM_PINS) Sim::modes[pin] = mode;
+  Sim::pinChanged(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  Sim::advance(Sim::pinCost());
+  if (pin < SIM_PINS) Sim::outputs[pin] = level;
+  Sim::setPin(pin, level);
+  Sim::pinChanged(pin);
+}
+
+int digitalRead(uint8_t pin) {
+  Sim::advance(Sim::pinCost());
+  return Sim::pin(pin);
+}
+
+int analogRead(uint8_t pin) {
+  return Sim::analog(pin);
+}
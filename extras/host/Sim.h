@@ -0,0 +1,87 @@
+#ifndef Sim_h
+#define Sim_h
+
+/*
+  Sim  simulated time, pins and I2C bus for the host build
+
+  Nothing runs in real time: the clock only moves when the code under test
+  waits (delay(), delayMicroseconds()), asks for the time (micros() and
+  millis() cost CPU time on the target too) or puts bytes on the bus. Bus
+  time is charged per bit at the clock set with Wire.setClock(), so a
+  transaction takes as long as on the target and its bytes land at the
+  right moment for the device models.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIM_PINS 32
+
+namespace Sim {
+
+// a device on the bus, see MCP23017_Model
+class I2CDevice {
+public:
+	I2CDevice(uint8_t address);
+	virtual ~I2CDevice();
+	uint8_t address() const { return _address; }
+	// a transaction starts, false NACKs the address
+	virtual bool start(bool read) = 0;
+	// a byte from the master, false NACKs it
+	virtual bool write(uint8_t value) = 0;
+	// a byte for the master
+	virtual uint8_t read() = 0;
+	virtual void stop() {}
+
+private:
+	uint8_t _address;
+	I2CDevice *_next;
+	friend I2CDevice *device(uint8_t address);
+};
+
+I2CDevice *device(uint8_t address);
+
+struct BusStats {
+	uint32_t transactions;
+	uint32_t bytes;       // address byte included
+	uint32_t nacks;
+	uint64_t timeNs;      // time the bus was busy
+
+	void reset();
+};
+
+// clock, in nanoseconds since the start
+uint64_t now();
+void advance(uint64_t ns);
+void reset();
+
+// CPU time charged for each micros()/millis() call, 4 us by default as on
+// a 16 MHz AVR; it also lets loops that wait on micros() make progress
+void setCallCost(uint32_t ns);
+uint32_t callCost();
+// the same for each digitalRead()/digitalWrite(), 3 us by default
+void setPinCost(uint32_t ns);
+uint32_t pinCost();
+
+// bus
+void setBusClock(uint32_t hz);
+uint32_t busClock();
+uint64_t bitTime();          // ns
+BusStats &bus();
+
+// Arduino pins as the outside world drives them
+void setPin(uint8_t pin, uint8_t level);
+uint8_t pin(uint8_t pin);
+// what the sketch made of a pin: the last pinMode() and digitalWrite()
+uint8_t mode(uint8_t pin);
+uint8_t output(uint8_t pin);
+// called after every pinMode()/digitalWrite(), e.g. to model an open
+// drain line; one listener, NULL removes it
+typedef void (*PinListener)(void *ctx, uint8_t pin);
+void setPinListener(PinListener fn, void *ctx);
+void setAnalog(uint8_t pin, uint16_t value);
+uint16_t analog(uint8_t pin);
+
+} // namespace Sim
+
+#endif // Sim_h
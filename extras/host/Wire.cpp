@@ -0,0 +1,121 @@
+#include "Wire.h"
+#include "Sim.h"
+
+// one state for all TwoWire objects, as the AVR twi driver has
+uint8_t TwoWire::txAddress = 0;
+uint8_t TwoWire::txBuffer[BUFFER_LENGTH];
+uint8_t TwoWire::txLength = 0;
+bool TwoWire::txOverflow = false;
+uint8_t TwoWire::rxBuffer[BUFFER_LENGTH];
+uint8_t TwoWire::rxIndex = 0;
+uint8_t TwoWire::rxLength = 0;
+
+TwoWire Wire;
+
+void TwoWire::begin() {
+}
+
+// slave mode is not simulated
+void TwoWire::begin(uint8_t address) {
+  (void)address;
+}
+
+void TwoWire::setClock(uint32_t hz) {
+  Sim::setBusClock(hz);
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  txAddress = address;
+  txLength = 0;
+  txOverflow = false;
+}
+
+// each byte is nine bits, the device sees it once its ACK bit is clocked
+static bool sendByte(Sim::I2CDevice *dev, uint8_t value) {
+  Sim::advance(9 * Sim::bitTime());
+  Sim::bus().bytes++;
+  return dev->write(value);
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+  (void)sendStop;
+  if (txOverflow) return 1;
+  Sim::BusStats &bus = Sim::bus();
+  uint64_t start = Sim::now();
+  bus.transactions++;
+
+  uint8_t status = 0;
+  Sim::I2CDevice *dev = Sim::device(txAddress);
+  Sim::advance(Sim::bitTime());  // START
+  Sim::advance(9 * Sim::bitTime());
+  bus.bytes++;
+  if (!dev || !dev->start(false)) {
+    status = 2;
+  } else {
+    for (uint8_t i = 0; i < txLength; i++) {
+      if (!sendByte(dev, txBuffer[i])) {
+        status = 3;
+        break;
+      }
+    }
+    dev->stop();
+  }
+  Sim::advance(Sim::bitTime());  // STOP
+  if (status) bus.nacks++;
+  bus.timeNs += Sim::now() - start;
+  txLength = 0;
+  return status;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
+  (void)sendStop;
+  Sim::BusStats &bus = Sim::bus();
+  uint64_t start = Sim::now();
+  bus.transactions++;
+  if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+
+  rxIndex = rxLength = 0;
+  Sim::I2CDevice *dev = Sim::device(address);
+  Sim::advance(10 * Sim::bitTime());  // START and address
+  bus.bytes++;
+  if (!dev || !dev->start(true)) {
+    bus.nacks++;
+  } else {
+    for (; rxLength < quantity; rxLength++) {
+      Sim::advance(9 * Sim::bitTime());
+      bus.bytes++;
+      rxBuffer[rxLength] = dev->read();
+    }
+    dev->stop();
+  }
+  Sim::advance(Sim::bitTime());  // STOP
+  bus.timeNs += Sim::now() - start;
+  return rxLength;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (txLength >= BUFFER_LENGTH) {
+    txOverflow = true;
+    return 0;
+  }
+  txBuffer[txLength++] = value;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+  size_t n = 0;
+  while ((n < quantity) && write(data[n])) n++;
+  return n;
+}
+
+int TwoWire::available() {
+  return rxLength - rxIndex;
+}
+
+int TwoWire::read() {
+  return (rxIndex < rxLength) ? rxBuffer[rxIndex++] : -1;
+}
+
+int TwoWire::peek() {
+  return (rxIndex < rxLength) ? rxBuffer[rxIndex] : -1;
+}
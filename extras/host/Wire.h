@@ -0,0 +1,46 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+/*
+  Host Wire: transactions go to the Sim device models at the address, and
+  every bit is charged to the simulated clock.
+*/
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire {
+public:
+	void begin();
+	void begin(uint8_t address);
+	void begin(int address) { begin((uint8_t)address); }
+	void setClock(uint32_t hz);
+
+	void beginTransmission(uint8_t address);
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	uint8_t endTransmission(uint8_t sendStop = true);
+
+	uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+	uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+
+	size_t write(uint8_t value);
+	size_t write(const uint8_t *data, size_t quantity);
+	int available();
+	int read();
+	int peek();
+
+private:
+	static uint8_t txAddress;
+	static uint8_t txBuffer[BUFFER_LENGTH];
+	static uint8_t txLength;
+	static bool txOverflow;
+	static uint8_t rxBuffer[BUFFER_LENGTH];
+	static uint8_t rxIndex;
+	static uint8_t rxLength;
+};
+
+extern TwoWire Wire;
+
+#endif // TwoWire_h
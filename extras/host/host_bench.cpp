@@ -0,0 +1,428 @@
+/*
+  host_bench  hot paths of the libraries on the emulated board
+
+  Every figure is simulated target time: bus traffic at the given I2C
+  clock plus the CPU time the Sim charges for micros(), millis() and pin
+  access. The library's own instructions are not timed, so the results
+  are a lower bound dominated by the bus, and identical on every run.
+
+  Prints one JSON object. With a limits file every metric listed there is
+  checked and the exit status is 1 if any is out of bounds:
+
+    host_bench [limits-file]
+
+  A limits line is "<metric> min|max <value>", # starts a comment.
+*/
+
+#include "Arduino.h"
+#include "Sim.h"
+#include "MCP23017_Model.h"
+#include "HD44780_Model.h"
+#include "Keypad_Model.h"
+
+#include "Keypad_I2C.h"
+#include "LCD_I2C.h"
+#include "LCD_Glyphs.h"
+#include "I2C_Scheduler.h"
+#include "FR_RotaryEncoder.h"
+
+#include <stdio.h>
+
+#define I2CADDR 0x27
+#define BENCH_METRICS 64
+
+const byte ROWS = 4;
+const byte COLS = 4;
+char keys[ROWS][COLS] = {
+  {'1','2','3','*'},
+  {'4','5','6','/'},
+  {'7','8','9','-'},
+  {'.','0','=','+'}
+};
+byte rowPins[] = {3,2,1,0};
+byte colPins[] = {4,5,6,7};
+
+const byte pinSCK = 8;
+const byte pinDT = 9;
+const byte pinSW = 7;
+
+MCP23017_Model chip(I2CADDR);
+HD44780_Model panel(chip);
+Keypad_Model pad(chip, rowPins, colPins, ROWS, COLS);
+
+Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, I2CADDR);
+LCD_I2C_Fixed<16, 2> lcd(I2CADDR);
+
+// bar graph cells, 0 to 5 columns lit, and a few icons: 10 glyphs
+const uint8_t glyphTable[][8] PROGMEM = {
+  {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00},
+  {0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10},
+  {0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x18},
+  {0x1C,0x1C,0x1C,0x1C,0x1C,0x1C,0x1C,0x1C},
+  {0x1E,0x1E,0x1E,0x1E,0x1E,0x1E,0x1E,0x1E},
+  {0x1F,0x1F,0x1F,0x1F,0x1F,0x1F,0x1F,0x1F},
+  {0x04,0x0E,0x0E,0x0E,0x1F,0x00,0x04,0x00},
+  {0x0E,0x11,0x11,0x1F,0x1B,0x1B,0x1F,0x00},
+  {0x04,0x0A,0x0A,0x0E,0x0E,0x1F,0x1F,0x0E},
+  {0x00,0x0A,0x1F,0x1F,0x0E,0x04,0x00,0x00}
+};
+LCD_Glyphs glyphs(lcd, glyphTable, sizeof(glyphTable) / sizeof(glyphTable[0]));
+
+/*********** results */
+struct Metric {
+  char name[40];
+  double value;
+  const char *unit;
+  char bound;       // 0 none, '<' max, '>' min
+  double limit;
+};
+
+static Metric metrics[BENCH_METRICS];
+static uint8_t metricCount = 0;
+
+static void record(const char *name, uint32_t clockHz, double value, const char *unit) {
+  if (metricCount >= BENCH_METRICS) return;
+  Metric &m = metrics[metricCount++];
+  snprintf(m.name, sizeof(m.name), "%s@%luk", name, (unsigned long)(clockHz / 1000));
+  m.value = value;
+  m.unit = unit;
+  m.bound = 0;
+  m.limit = 0;
+}
+
+static bool loadLimits(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[128], name[40], kind[8];
+  double limit;
+  while (fgets(line, sizeof(line), f)) {
+    if ((line[0] == '#') || (sscanf(line, "%39s %7s %lf", name, kind, &limit) != 3)) continue;
+    for (uint8_t i = 0; i < metricCount; i++) {
+      if (strcmp(metrics[i].name, name)) continue;
+      metrics[i].bound = strcmp(kind, "min") ? '<' : '>';
+      metrics[i].limit = limit;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool passed(const Metric &m) {
+  if (m.bound == '<') return m.value <= m.limit;
+  if (m.bound == '>') return m.value >= m.limit;
+  return true;
+}
+
+/*********** measurements */
+static uint64_t t0;
+static Sim::BusStats bus0;
+
+static void start() {
+  bus0 = Sim::bus();
+  t0 = Sim::now();
+}
+
+static double elapsedUs() {
+  return (Sim::now() - t0) / 1000.0;
+}
+
+static uint32_t transactions() {
+  return Sim::bus().transactions - bus0.transactions;
+}
+
+static uint32_t bytes() {
+  return Sim::bus().bytes - bus0.bytes;
+}
+
+static void benchLcd(uint32_t hz) {
+  static const char text[] = "The quick brown fox jumps over the lazy dog 0123456789";
+  const uint8_t len = sizeof(text) - 1;
+
+  lcd.setCursor(0, 0);
+  start();
+  lcd.print(text);
+  record("lcd.chars_per_s", hz, len / (elapsedUs() / 1e6), "chars/s");
+  record("lcd.bytes_per_char", hz, (double)bytes() / len, "bytes");
+
+  start();
+  lcd.setCursor(0, 0);
+  lcd.print("Temp   23.45 C  ");
+  lcd.setCursor(0, 1);
+  lcd.print("Light  512      ");
+  record("lcd.redraw_us", hz, elapsedUs(), "us");
+  record("lcd.redraw_transactions", hz, transactions(), "transactions");
+
+  start();
+  for (uint8_t i = 0; i < 10; i++) {
+    lcd.setCursor(7, 0);
+    lcd.print(i * 1111 % 10000);
+  }
+  record("lcd.field_us", hz, elapsedUs() / 10, "us");
+
+  start();
+  for (uint8_t i = 0; i < 10; i++) lcd.printField(7, 0, 6, i * 1111L % 10000, 2);
+  record("lcd.print_field_us", hz, elapsedUs() / 10, "us");
+  record("lcd.print_field_transactions", hz, transactions() / 10.0, "transactions");
+
+  // framebuffer: a full change, then a single cell
+  lcd.enableFramebuffer();
+  lcd.flush();
+  start();
+  lcd.setCursor(0, 0);
+  lcd.print("0123456789ABCDEF");
+  lcd.setCursor(0, 1);
+  lcd.print("FEDCBA9876543210");
+  lcd.flush();
+  record("lcd.fb_redraw_us", hz, elapsedUs(), "us");
+  start();
+  lcd.setCursor(5, 1);
+  lcd.print('x');
+  lcd.flush();
+  record("lcd.fb_one_cell_us", hz, elapsedUs(), "us");
+  lcd.disableFramebuffer();
+
+  // a bar graph frame once its glyphs are resident, then one upload
+  glyphs.begin();
+  lcd.setCursor(0, 1);
+  for (uint8_t g = 0; g < 6; g++) glyphs.print(g);
+  lcd.setCursor(0, 1);
+  start();
+  for (uint8_t g = 0; g < 6; g++) glyphs.print(5 - g);
+  record("glyph.resident_us", hz, elapsedUs() / 6, "us");
+  start();
+  glyphs.print(6);
+  glyphs.print(7);
+  glyphs.print(8);  // evicts the least recently used bar cell
+  record("glyph.upload_us", hz, elapsedUs() / 3, "us");
+}
+
+static void benchKeypad(uint32_t hz) {
+  delay(20);  // past the debounce time, getKey() scans
+  start();
+  keypad.getKey();
+  record("keypad.scan_us", hz, elapsedUs(), "us");
+  record("keypad.scan_transactions", hz, transactions(), "transactions");
+
+  pad.press(2, 1);
+  delay(20);
+  start();
+  char key = keypad.getKey();
+  record("keypad.press_us", hz, elapsedUs(), "us");
+  pad.releaseAll();
+  delay(20);
+  keypad.getKey();
+  if (key != '8') fprintf(stderr, "keypad: got '%c' for '8'\n", key ? key : '-');
+
+  // asynchronous scan, getKey() polled every millisecond: the longest call
+  // and how long the press takes to come out
+  keypad.enableAsync();
+  pad.press(2, 1);
+  unsigned long pressed = micros();
+  unsigned long longest = 0;
+  key = NO_KEY;
+  for (uint16_t i = 0; (i < 200) && (key == NO_KEY); i++) {
+    delay(1);
+    start();
+    key = keypad.getKey();
+    if (elapsedUs() > longest) longest = elapsedUs();
+  }
+  record("keypad.async_call_max_us", hz, longest, "us");
+  record("keypad.async_press_ms", hz, (micros() - pressed) / 1000.0, "ms");
+  pad.releaseAll();
+  for (uint8_t i = 0; i < 100; i++) {
+    delay(1);
+    keypad.getKey();
+  }
+  keypad.disableAsync();
+  if (key != '8') fprintf(stderr, "keypad async: got '%c' for '8'\n", key ? key : '-');
+}
+
+// a loop() that changes a bank A latch bit for the keypad and the
+// backlight on bank B, then ends: with and without write combining
+static void benchCombining(uint32_t hz) {
+  MCP23017 *expander = MCP23017::attach(I2CADDR);
+  word latch = expander->cached(OLATA);
+  static const char *names[2][2] = {
+    { "mcp.port_update_us", "mcp.port_update_transactions" },
+    { "mcp.combined_update_us", "mcp.combined_update_transactions" }
+  };
+  for (uint8_t combine = 0; combine < 2; combine++) {
+    expander->setCombining(combine);
+    start();
+    for (uint8_t i = 0; i < 10; i++) {
+      keypad.port_write(latch ^ ((i & 1) ? 0 : 0x80));
+      lcd.setBacklight((i & 1) ? HIGH : LOW);
+      expander->flush();
+      if ((chip.reg(OLATA) != expander->cached(OLATA)) || (chip.reg(OLATB) != expander->cached(OLATB)))
+        fprintf(stderr, "combining: chip latches differ from the copy\n");
+    }
+    record(names[combine][0], hz, elapsedUs() / 10, "us");
+    record(names[combine][1], hz, transactions() / 10.0, "transactions");
+  }
+  expander->setCombining(false);
+  keypad.port_write(latch);
+  lcd.setBacklight(HIGH);
+}
+
+// the encoder turns clockwise at a steady rate, update() is polled every
+// pollUs; true if no detent was lost
+static bool encoderTracks(uint32_t detentsPerSec, uint32_t pollUs, uint16_t detents) {
+  static const uint8_t cw[4] = { 1, 0, 2, 3 };  // CLK << 1 | DT, from 3
+  Sim::setPin(pinSCK, HIGH);
+  Sim::setPin(pinDT, HIGH);
+  Sim::setPin(pinSW, HIGH);
+  RotaryEncoder encoder(pinSCK, pinDT, pinSW);
+  encoder.setRotaryLimits(-30000, 30000, false);
+  encoder.setPosition(0);
+
+  uint64_t step = 1000000000ULL / (4ULL * detentsPerSec);
+  uint64_t begin = Sim::now();
+  uint64_t next = begin + step / 3;  // off the poll grid
+  uint64_t poll = begin;
+  uint32_t done = 0, total = 4UL * detents;
+  while (done < total) {
+    if (Sim::now() < poll) Sim::advance(poll - Sim::now());
+    while ((done < total) && (next <= Sim::now())) {
+      uint8_t state = cw[done % 4];
+      Sim::setPin(pinSCK, state >> 1);
+      Sim::setPin(pinDT, state & 1);
+      done++;
+      next += step;
+    }
+    encoder.update();
+    poll += pollUs * 1000ULL;
+  }
+  encoder.update();
+  return abs(encoder.getPosition()) == detents;
+}
+
+static void benchEncoder(uint32_t hz) {
+  Sim::setPin(pinSCK, HIGH);
+  Sim::setPin(pinDT, HIGH);
+  Sim::setPin(pinSW, HIGH);
+  RotaryEncoder encoder(pinSCK, pinDT, pinSW);
+  start();
+  for (uint8_t i = 0; i < 100; i++) encoder.update();
+  record("encoder.update_us", hz, elapsedUs() / 100, "us");
+
+  static const uint16_t polls[] = { 1000, 250 };
+  for (uint8_t p = 0; p < sizeof(polls) / sizeof(polls[0]); p++) {
+    uint32_t best = 0;
+    for (uint32_t rate = 10; rate <= 20000; rate += rate / 20 + 1) {
+      if (!encoderTracks(rate, polls[p], 200)) break;
+      best = rate;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "encoder.max_detents_%uus", polls[p]);
+    record(name, hz, best, "detents/s");
+  }
+}
+
+// Three more boards at 0x20-0x22 next to the one at 0x27: every display
+// redraws its whole screen every 50 ms while one keypad is used. Reports
+// how long a due keypad scan waits for the bus and what each board gets.
+MCP23017_Model chips[3] = { MCP23017_Model(0x20), MCP23017_Model(0x21), MCP23017_Model(0x22) };
+HD44780_Model panels[3] = { HD44780_Model(chips[0]), HD44780_Model(chips[1]), HD44780_Model(chips[2]) };
+Keypad_Model pads[3] = {
+  Keypad_Model(chips[0], rowPins, colPins, ROWS, COLS),
+  Keypad_Model(chips[1], rowPins, colPins, ROWS, COLS),
+  Keypad_Model(chips[2], rowPins, colPins, ROWS, COLS)
+};
+LCD_I2C lcds[3] = { LCD_I2C(0x20), LCD_I2C(0x21), LCD_I2C(0x22) };
+Keypad_I2C keypads[3] = {
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, 0x20),
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, 0x21),
+  Keypad_I2C(makeKeymap(keys), rowPins, colPins, ROWS, COLS, 0x22)
+};
+I2C_Scheduler bus;
+
+static void benchScheduler(uint32_t hz) {
+  LCD_I2C *displays[4] = { &lcd, &lcds[0], &lcds[1], &lcds[2] };
+  Keypad_I2C *pads4[4] = { &keypad, &keypads[0], &keypads[1], &keypads[2] };
+  for (uint8_t i = 0; i < 3; i++) {
+    panels[i].begin(16, 2);
+    keypads[i].begin();
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    bus.addStation(displays[i], pads4[i]);
+    if (i) displays[i]->begin(16, 2);
+    displays[i]->enableFramebuffer();
+  }
+  while (bus.run());
+  for (uint8_t i = 0; i < 4; i++) bus.resetStats(i);
+
+  uint8_t pressed = 0, seen = 0;
+  unsigned long frame = millis();
+  uint16_t frames = 0;
+  while (frames < 40) {
+    if (millis() - frame >= 50) {
+      frame += 50;
+      frames++;
+      for (uint8_t i = 0; i < 4; i++) {
+        displays[i]->printField(0, 0, 16, (long)frames * 1111 + i, 0);
+        displays[i]->printField(0, 1, 16, (long)frames * 7777 + i, 2);
+      }
+      // a key on the last board every fifth frame, held for two
+      if (frames % 5 == 1) {
+        pads[2].press(0, frames % 4);
+        pressed++;
+      }
+      if (frames % 5 == 3) pads[2].releaseAll();
+    }
+    if (bus.getKey(3) != NO_KEY) seen++;
+    if (!bus.run()) delayMicroseconds(100);
+  }
+
+  while (bus.run());
+  uint16_t lateMax = 0;
+  uint32_t scans = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    Station_Stats &s = bus.getStats(i);
+    if (s.scanLateMax > lateMax) lateMax = s.scanLateMax;
+    scans += s.scans;
+  }
+  record("sched.scan_late_max_us", hz, lateMax, "us");
+  record("sched.scans_per_s", hz, scans / 2.0, "scans/s");
+  record("sched.station_bytes_per_s", hz, bus.throughput(3), "bytes/s");
+  record("sched.keys_missed", hz, pressed - seen, "keys");
+}
+
+int main(int argc, char **argv) {
+  panel.begin(16, 2);
+  Wire.begin();
+  keypad.begin();
+  lcd.begin();
+  lcd.setBacklight(HIGH);
+
+  static const uint32_t clocks[] = { 100000, 400000 };
+  for (uint8_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+    Wire.setClock(clocks[i]);
+    benchLcd(clocks[i]);
+    benchKeypad(clocks[i]);
+    benchCombining(clocks[i]);
+    // the encoder does not use the bus, once is enough
+    if (i == 0) benchEncoder(clocks[i]);
+  }
+  // switches the main display to asynchronous mode, so it comes last
+  benchScheduler(clocks[1]);
+
+  if ((argc > 1) && !loadLimits(argv[1])) {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 2;
+  }
+
+  uint32_t violations = panel.violations();
+  for (uint8_t i = 0; i < 3; i++) violations += panels[i].violations();
+  bool ok = violations == 0;
+  printf("{\n  \"violations\": %lu,\n  \"metrics\": [\n", (unsigned long)violations);
+  for (uint8_t i = 0; i < metricCount; i++) {
+    const Metric &m = metrics[i];
+    bool pass = passed(m);
+    ok = ok && pass;
+    printf("    {\"name\": \"%s\", \"value\": %.2f, \"unit\": \"%s\"", m.name, m.value, m.unit);
+    if (m.bound) printf(", \"%s\": %.2f, \"pass\": %s", (m.bound == '<') ? "max" : "min", m.limit, pass ? "true" : "false");
+    printf("}%s\n", (i + 1 < metricCount) ? "," : "");
+  }
+  printf("  ],\n  \"pass\": %s\n}\n", ok ? "true" : "false");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/*
+  host_demo  the sample's LCD and keypad on the emulated board
+
+  Prints a line, presses a key and shows what the panel displays, then
+  repeats a screen update at each bus clock to compare bytes and bus time.
+*/
+
+#include "Arduino.h"
+#include "Sim.h"
+#include "MCP23017_Model.h"
+#include "HD44780_Model.h"
+#include "Keypad_Model.h"
+
+#include "Keypad_I2C.h"
+#include "LCD_I2C.h"
+
+#include <stdio.h>
+
+#define I2CADDR 0x27
+
+const byte ROWS = 4;
+const byte COLS = 4;
+char keys[ROWS][COLS] = {
+  {'1','2','3','*'},
+  {'4','5','6','/'},
+  {'7','8','9','-'},
+  {'.','0','=','+'}
+};
+byte rowPins[] = {3,2,1,0};
+byte colPins[] = {4,5,6,7};
+
+MCP23017_Model chip(I2CADDR);
+HD44780_Model panel(chip);
+Keypad_Model pad(chip, rowPins, colPins, ROWS, COLS);
+
+Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, I2CADDR);
+LCD_I2C lcd(I2CADDR);
+
+static void show() {
+  printf("  |%s|\n  |%s|\n", panel.line(0), panel.line(1));
+}
+
+static void report(const char *what) {
+  Sim::BusStats &bus = Sim::bus();
+  printf("  %-22s %5lu transactions %6lu bytes %8.3f ms bus  %lu strobes %lu violations\n", what,
+         (unsigned long)bus.transactions, (unsigned long)bus.bytes, bus.timeNs / 1e6,
+         (unsigned long)panel.strobes(), (unsigned long)panel.violations());
+}
+
+static void start() {
+  Sim::bus().reset();
+  panel.resetCounters();
+}
+
+static char waitKey(unsigned long ms) {
+  unsigned long t0 = millis();
+  while (millis() - t0 < ms) {
+    char key = keypad.getKey();
+    if (key) return key;
+  }
+  return NO_KEY;
+}
+
+int main() {
+  panel.begin(16, 2);
+  Wire.begin();
+  keypad.begin();
+  lcd.begin(16, 2);
+  lcd.setBacklight(HIGH);
+  lcd.print("Hello, host!");
+
+  pad.press(1, 2);  // '6'
+  char key = waitKey(100);
+  pad.releaseAll();
+  lcd.setCursor(0, 1);
+  lcd.print("key ");
+  lcd.print(key ? key : '-');
+  printf("panel after start-up:\n");
+  show();
+
+  static const uint32_t clocks[] = { 100000, 400000, 1000000 };
+  printf("\none 16x2 screen update:\n");
+  for (uint8_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+    Wire.setClock(clocks[i]);
+    start();
+    lcd.setCursor(0, 0);
+    lcd.print("Temp   23.45 C  ");
+    lcd.setCursor(0, 1);
+    lcd.print("Light  512      ");
+    char what[24];
+    snprintf(what, sizeof(what), "%lu kHz", (unsigned long)(clocks[i] / 1000));
+    report(what);
+  }
+  show();
+
+  printf("\none keypad scan:\n");
+  for (uint8_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+    Wire.setClock(clocks[i]);
+    delay(20);
+    start();
+    keypad.getKey();
+    char what[24];
+    snprintf(what, sizeof(what), "%lu kHz", (unsigned long)(clocks[i] / 1000));
+    report(what);
+  }
+  return (key == '6') ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+/*
+  host_test  checks of library behaviour on the emulated board
+
+  Each test drives the library against the device models and checks what
+  the bus or the pins saw. Prints one line per failed check and a summary,
+  the exit status is 1 if anything failed.
+*/
+
+#include "Arduino.h"
+#include "Sim.h"
+
+#include "MCP23017_Model.h"
+#include "HD44780_Model.h"
+#include "Keypad_Model.h"
+
+#include "Wire.h"
+#include "I2C_Bus.h"
+#include "MCP23017.h"
+#include "Task_Scheduler.h"
+#include "Keypad_I2C.h"
+#include "LCD_I2C.h"
+#include "LCD_Glyphs.h"
+#include "I2C_Scheduler.h"
+
+#include <stdio.h>
+
+static uint16_t checks = 0;
+static uint16_t failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+static void check(bool ok, const char *what, const char *file, int line) {
+  checks++;
+  if (ok) return;
+  failures++;
+  printf("%s:%d: failed: %s\n", file, line, what);
+}
+
+/*********** bus recovery */
+
+// Open drain SDA and SCL with pull-ups and a slave that holds SDA low for
+// a number of SCL clocks, as one does when a transaction is cut off in
+// the middle of a byte it sends.
+class StuckSlave {
+public:
+  StuckSlave(uint8_t clocks) : _hold(clocks), _clocks(0), _sclLow(false) {
+    Sim::setPinListener(lines, this);
+    update();
+  }
+  ~StuckSlave() { Sim::setPinListener(NULL, NULL); }
+  uint8_t clocks() const { return _clocks; }
+
+private:
+  static bool pulledLow(uint8_t pin) {
+    return (Sim::mode(pin) == OUTPUT) && (Sim::output(pin) == LOW);
+  }
+  static void lines(void *ctx, uint8_t pin) {
+    (void)pin;
+    ((StuckSlave *)ctx)->update();
+  }
+  void update() {
+    bool sclLow = pulledLow(PIN_WIRE_SCL);
+    if (_sclLow && !sclLow) {
+      _clocks++;
+      if (_hold) _hold--;
+    }
+    _sclLow = sclLow;
+    Sim::setPin(PIN_WIRE_SCL, sclLow ? LOW : HIGH);
+    Sim::setPin(PIN_WIRE_SDA, (pulledLow(PIN_WIRE_SDA) || _hold) ? LOW : HIGH);
+  }
+  uint8_t _hold;
+  uint8_t _clocks;
+  bool _sclLow;
+};
+
+static void testRecover() {
+  I2C_Stats stats;
+  {
+    StuckSlave slave(5);
+    CHECK(Sim::pin(PIN_WIRE_SDA) == LOW);
+    CHECK(I2CBus.recover(&stats));
+    CHECK(slave.clocks() == 5);
+    CHECK(Sim::pin(PIN_WIRE_SDA) == HIGH);
+    CHECK(Sim::pin(PIN_WIRE_SCL) == HIGH);
+  }
+  {
+    // nine clocks are all it gets
+    StuckSlave slave(20);
+    CHECK(!I2CBus.recover(&stats));
+    CHECK(slave.clocks() == 9);
+  }
+  {
+    // a free bus only gets the STOP
+    StuckSlave slave(0);
+    CHECK(I2CBus.recover(&stats));
+    CHECK(slave.clocks() == 0);
+  }
+  CHECK(stats.recoveries == 3);
+}
+
+/*********** expander */
+
+// begin() reads the register map in two halves, 0x00-0x0A and 0x0B-0x15
+static void testExpanderBegin() {
+  MCP23017_Model chip(0x21);
+  {
+    MCP23017 expander(0x21);
+    expander.begin();
+    CHECK(expander.getStats().transactions == 3);  // IOCON, two halves
+    CHECK(expander.getStats().failures == 0);
+    CHECK(chip.wrapReads() == 0);
+    bool same = true;
+    for (uint8_t r = 0; r < MCP23017_REGISTERS; r++) {
+      if (expander.cached(r) != chip.reg(r)) same = false;
+    }
+    CHECK(same);
+    CHECK(MCP23017::attach(0x21) == &expander);
+  }
+  // gone from the list with its scope, attach() makes a new one
+  MCP23017 *e = MCP23017::attach(0x21);
+  CHECK(e->getStats().transactions == 0);
+  delete e;
+}
+
+/*********** keypad */
+
+static char keymap[2][2] = { { '1', '2' }, { '3', '4' } };
+static byte rowPins[2] = { 0, 1 };
+static byte colPins[2] = { 4, 5 };
+
+// an idle keypad polling INTFA reads it once per debounce interval, not
+// once per getKey(), and still sees the next key
+static void testKeypadIdlePoll() {
+  MCP23017_Model chip(0x26);
+  Keypad_Model pad(chip, rowPins, colPins, 2, 2);
+  Keypad_I2C keypad(makeKeymap(keymap), rowPins, colPins, 2, 2, 0x26);
+  keypad.begin();
+  keypad.enableInterrupt();
+  keypad.setDebounceTime(10);
+  while (keypad.getKey() != NO_KEY);
+  delay(20);
+  keypad.getKey();                           // arms
+
+  uint32_t before = keypad.getStats().transactions;
+  unsigned long start = millis();
+  while (millis() - start < 100) keypad.getKey();
+  uint32_t polls = keypad.getStats().transactions - before;
+  CHECK((polls >= 9) && (polls <= 11));
+
+  pad.press(1, 0);
+  char key = NO_KEY;
+  start = millis();
+  while ((key == NO_KEY) && (millis() - start < 50)) key = keypad.getKey();
+  CHECK(key == '3');
+}
+
+/*********** fields */
+
+// every integer type picks an overload, unsigned ones above LONG_MAX too
+static void testFieldTypes() {
+  MCP23017_Model chip(0x22);
+  HD44780_Model panel(chip);
+  LCD_I2C lcd(0x22);
+  panel.begin(16, 2);
+  lcd.begin(16, 2);
+  uint8_t u8 = 200;
+  uint16_t u16 = 65535;
+  unsigned int ui = 40000U;
+  unsigned long ul = 4000000000UL;
+  int16_t i16 = -32768;
+  lcd.printField(0, 0, 3, u8);
+  lcd.printField(3, 0, 6, u16);
+  lcd.printField(9, 0, 7, ui, 2);
+  lcd.printField(0, 1, 10, ul);
+  lcd.printField(10, 1, 6, i16);
+  CHECK(strncmp(panel.line(0), "200 65535 400.00", 16) == 0);
+  CHECK(strncmp(panel.line(1), "4000000000-32768", 16) == 0);
+  lcd.printField(0, 1, 16, 0);
+  CHECK(strncmp(panel.line(1), "               0", 16) == 0);
+}
+
+/*********** glyphs */
+
+static const uint8_t arrow[][8] PROGMEM = {
+  { 0x04, 0x0E, 0x1F, 0x04, 0x04, 0x04, 0x04, 0x00 }
+};
+
+// the glyph in CGRAM slot 0 can go in a string
+static void testGlyphInString() {
+  MCP23017_Model chip(0x23);
+  HD44780_Model panel(chip);
+  LCD_I2C lcd(0x23);
+  panel.begin(16, 2);
+  lcd.begin(16, 2);
+  LCD_Glyphs glyphs(lcd, arrow, 1);
+  char text[] = { (char)glyphs.code(0), 'u', 'p', 0 };
+  CHECK(glyphs.resident(0));
+  lcd.setCursor(0, 0);
+  lcd.print(text);
+  CHECK(strncmp(panel.line(0), "0up ", 4) == 0);
+  CHECK(panel.ddram(0) == 8);
+  CHECK(panel.cgram(2) == 0x1F);
+}
+
+/*********** task scheduler */
+
+static void nothing() {
+}
+
+// a periodic task that comes 3.5 periods late keeps its phase
+static void testTaskPhase() {
+  Task_Scheduler tasks;
+  unsigned long t0 = micros();
+  int8_t id = tasks.every(10000, nothing);
+  delay(35);
+  CHECK(tasks.run());
+  CHECK(tasks.getStats(id).overruns == 1);
+  // due again at t0 + 40 ms, give or take the cost of micros()
+  long due = (long)(micros() + tasks.idle() - t0);
+  CHECK((due > 39950) && (due < 40050));
+}
+
+// a one-shot that re-arms itself gets a fresh slot and fresh stats
+static Task_Scheduler *rearming;
+static int8_t rearmed;
+
+static void slowOnce() {
+  delay(5);
+  rearmed = rearming->after(1000, nothing);
+}
+
+static void testTaskRearm() {
+  Task_Scheduler tasks;
+  rearming = &tasks;
+  int8_t id = tasks.after(0, slowOnce);
+  CHECK(tasks.run());
+  CHECK(rearmed >= 0);
+  CHECK(rearmed != id);
+  CHECK(tasks.getStats(id).runMax >= 5000);
+  CHECK(tasks.getStats(rearmed).runs == 0);
+  CHECK(tasks.getStats(rearmed).runMax == 0);
+  delay(2);
+  CHECK(tasks.run());                        // the re-armed one
+  CHECK(!tasks.run());                       // both slots free again
+  CHECK(tasks.idle() == 0xFFFFFFFFUL);
+}
+
+/*********** bus scheduler */
+
+// a station's bytes are what its expander sent since the reset, and every
+// display turn puts one transaction on the bus
+static void testStationStats() {
+  MCP23017_Model chip(0x24);
+  HD44780_Model panel(chip);
+  LCD_I2C lcd(0x24);
+  I2C_Scheduler bus;
+  panel.begin(16, 2);
+  lcd.begin(16, 2);
+  int8_t id = bus.addStation(&lcd, NULL);
+  CHECK(id == 0);
+  lcd.enableFramebuffer();
+  while (bus.run());
+  bus.resetStats(id);
+  I2C_Stats before = lcd.getStats();
+
+  lcd.printField(0, 0, 16, 12345L, 0);
+  lcd.printField(0, 1, 16, 67890L, 0);
+  unsigned long start = millis();
+  while (bus.run() || (millis() - start < 20)) delayMicroseconds(100);
+
+  Station_Stats &s = bus.getStats(id);
+  CHECK(s.bytes > 0);
+  CHECK(s.bytes == lcd.getStats().bytes - before.bytes);
+  CHECK(s.turns == lcd.getStats().transactions - before.transactions);
+  CHECK(strncmp(panel.line(1), "           67890", 16) == 0);
+}
+
+int main() {
+  Wire.begin();
+  testRecover();
+  testExpanderBegin();
+  testKeypadIdlePoll();
+  testGlyphInString();
+  testFieldTypes();
+  testTaskPhase();
+  testTaskRearm();
+  testStationStats();
+
+  printf("%u checks, %u failed\n", checks, failures);
+  return failures ? 1 : 0;
+}